@@ -0,0 +1,73 @@
+/* Licensed under the MIT License. */
+
+#include <time.h>
+#include <applibs/log.h>
+#include "boot_timeline.h"
+
+static const char *const phaseNames[BootPhase_Count] = {
+    [BootPhase_Epoll] = "epoll",
+    [BootPhase_Gpio] = "gpio",
+    [BootPhase_Uart] = "uart",
+    [BootPhase_PowerPulse] = "power pulse",
+    [BootPhase_InitDone] = "init done",
+    [BootPhase_FirstByte] = "first byte",
+    [BootPhase_Configured] = "configured",
+    [BootPhase_FirstFix] = "first fix",
+};
+
+static struct timespec startTime;
+static long phaseMs[BootPhase_Count];
+static bool phaseMarked[BootPhase_Count];
+
+static long MsSinceStart(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - startTime.tv_sec) * 1000 + (now.tv_nsec - startTime.tv_nsec) / 1000000;
+}
+
+void BootTimeline_Start(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    for (int i = 0; i < BootPhase_Count; i++) {
+        phaseMarked[i] = false;
+    }
+}
+
+void BootTimeline_Mark(BootPhase phase)
+{
+    if (phase < 0 || phase >= BootPhase_Count || phaseMarked[phase]) {
+        return;
+    }
+    phaseMs[phase] = MsSinceStart();
+    phaseMarked[phase] = true;
+}
+
+bool BootTimeline_IsMarked(BootPhase phase)
+{
+    return phase >= 0 && phase < BootPhase_Count && phaseMarked[phase];
+}
+
+long BootTimeline_ElapsedMs(BootPhase phase)
+{
+    return BootTimeline_IsMarked(phase) ? phaseMs[phase] : -1;
+}
+
+void BootTimeline_Report(void)
+{
+    long previousMs = 0;
+
+    Log_Debug("Boot timeline:\n");
+    for (int i = 0; i < BootPhase_Count; i++) {
+        if (!phaseMarked[i]) {
+            continue;
+        }
+        // The receiver milestones are not ordered relative to each other, so only
+        // report deltas against the last milestone that happened before
+        long deltaMs = phaseMs[i] >= previousMs ? phaseMs[i] - previousMs : 0;
+        Log_Debug("  %-12s %6ld ms (+%ld ms)\n", phaseNames[i], phaseMs[i], deltaMs);
+        if (phaseMs[i] > previousMs) {
+            previousMs = phaseMs[i];
+        }
+    }
+}
@@ -0,0 +1,48 @@
+/* Licensed under the MIT License. */
+
+#pragma once
+#include <stdbool.h>
+
+/// <summary>
+///     Milestones recorded between application start and the first GPS fix.
+///     The init steps are listed in the order InitPeripheralsAndHandlers runs them.
+/// </summary>
+typedef enum {
+    BootPhase_Epoll,          ///< epoll instance created
+    BootPhase_Gpio,           ///< PWR, WAKEUP and LED GPIOs opened
+    BootPhase_Uart,           ///< UART open and registered, receiving
+    BootPhase_PowerPulse,     ///< WAKEUP read and PWR pulse started if needed
+    BootPhase_InitDone,       ///< all handlers registered
+    BootPhase_FirstByte,      ///< first byte received from the receiver
+    BootPhase_Configured,     ///< receiver configuration pipeline finished
+    BootPhase_FirstFix,       ///< first fix committed by the parser (TTFF)
+    BootPhase_Count
+} BootPhase;
+
+/// <summary>
+///     Starts the timeline; all milestones are relative to this call.
+/// </summary>
+void BootTimeline_Start(void);
+
+/// <summary>
+///     Records a milestone. Only the first call for each phase is kept, so this is
+///     cheap to call from handlers that run repeatedly.
+/// </summary>
+/// <param name="phase">The milestone reached</param>
+void BootTimeline_Mark(BootPhase phase);
+
+/// <summary>
+///     Returns true once the given milestone has been recorded.
+/// </summary>
+bool BootTimeline_IsMarked(BootPhase phase);
+
+/// <summary>
+///     Milliseconds from BootTimeline_Start to the milestone, or -1 if not reached.
+/// </summary>
+long BootTimeline_ElapsedMs(BootPhase phase);
+
+/// <summary>
+///     Logs every milestone reached so far with its time since start and since the
+///     previous milestone.
+/// </summary>
+void BootTimeline_Report(void);
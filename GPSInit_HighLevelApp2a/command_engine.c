@@ -0,0 +1,309 @@
+/* Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <applibs/log.h>
+#include "command_engine.h"
+
+// NMEA 0183 limits a sentence to 82 characters including "$" and "\r\n"
+#define COMMAND_SENTENCE_MAX 82
+
+// Once a command has left the transmit queue it may still be in the UART's FIFO:
+// at 4800 baud a full sentence takes 170 ms on the wire. Sentences starting within
+// this long of the queue draining may predate the command and are not counted
+#define COMMAND_SETTLE_MS 250
+
+typedef struct InFlight {
+    size_t step;
+    int64_t deadlineMs;
+    unsigned int attemptsLeft;
+    bool sent;                  ///< left the transmit queue
+    int64_t countFromMs;        ///< sentences starting from then on count, once sent
+    bool seen;                  ///< an Absent step's sentence showed up
+} InFlight;
+
+static UartTxQueue *txQueue;
+static const CommandStep *pipeline;
+static size_t pipelineLength;
+static size_t nextStep;
+static InFlight inFlight[COMMAND_MAX_IN_FLIGHT];
+static size_t inFlightCount;
+static int64_t startMs;
+static CommandStatus status;
+
+// Sentence being received, everything after the '$', and when it started
+static char line[COMMAND_SENTENCE_MAX];
+static size_t lineLength;
+static bool inSentence;
+static int64_t lineStartMs;
+
+static int64_t MonotonicMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static int HexValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static uint8_t Checksum(const char *body, size_t length)
+{
+    uint8_t parity = 0;
+    for (size_t i = 0; i < length; i++) {
+        parity ^= (uint8_t)body[i];
+    }
+    return parity;
+}
+
+static void Finish(CommandState state)
+{
+    status.state = state;
+    status.elapsedMs = MonotonicMs() - startMs;
+    inFlightCount = 0;
+    if (state == CommandState_Done) {
+        Log_Debug("Commands: %zu steps done in %lld ms (%zu skipped, %u resends)\n",
+                  status.completed, (long long)status.elapsedMs, status.skipped, status.resends);
+    } else {
+        Log_Debug("Commands: failed at step %zu after %lld ms\n", status.failedStep,
+                  (long long)status.elapsedMs);
+    }
+}
+
+// Queues one attempt of a step; returns false if the transmit queue is full or the
+// step cannot be sent at all, in which case the pipeline has failed
+static bool Send(size_t step)
+{
+    char sentence[COMMAND_SENTENCE_MAX + 1];
+    const char *body = pipeline[step].body;
+    size_t bodyLength = strlen(body);
+
+    int length = snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body,
+                          Checksum(body, bodyLength));
+    if (length < 0 || (size_t)length >= sizeof(sentence)) {
+        Log_Debug("ERROR: Command %zu is too long\n", step);
+        status.failedStep = step;
+        Finish(CommandState_Failed);
+        return false;
+    }
+    return UartTx_Enqueue(txQueue, sentence, (size_t)length) == 0;
+}
+
+static void RemoveInFlight(size_t slot)
+{
+    inFlight[slot] = inFlight[--inFlightCount];
+}
+
+static void Track(InFlight *entry, const CommandStep *step, int64_t now)
+{
+    entry->deadlineMs = now + step->timeoutMs;
+    entry->sent = false;
+    entry->seen = false;
+}
+
+// Once the transmit queue has drained, every queued step has reached the UART: their
+// timeouts start after the settle time, and so do the sentences that count for them
+static void MarkSent(int64_t now)
+{
+    if (UartTx_Pending(txQueue)) {
+        return;
+    }
+    for (size_t slot = 0; slot < inFlightCount; slot++) {
+        InFlight *entry = &inFlight[slot];
+        if (!entry->sent) {
+            entry->sent = true;
+            entry->countFromMs = now + COMMAND_SETTLE_MS;
+            entry->deadlineMs = entry->countFromMs + pipeline[entry->step].timeoutMs;
+        }
+    }
+}
+
+// Resends a step whose attempt failed, or, out of retries, skips it if optional and
+// otherwise fails the pipeline. Returns true if the step is still in flight
+static bool Retry(size_t slot, int64_t now)
+{
+    InFlight *entry = &inFlight[slot];
+    const CommandStep *step = &pipeline[entry->step];
+
+    if (entry->attemptsLeft != 0) {
+        // A full queue just delays the resend to the next poll
+        if (Send(entry->step)) {
+            entry->attemptsLeft--;
+            Track(entry, step, now);
+            status.resends++;
+        }
+        return true;
+    }
+    if (step->flags & CommandFlag_Optional) {
+        Log_Debug("Commands: %s not confirmed, skipped\n", step->body);
+        status.skipped++;
+        RemoveInFlight(slot);
+        return false;
+    }
+    Log_Debug("Commands: %s not confirmed\n", step->body);
+    status.failedStep = entry->step;
+    Finish(CommandState_Failed);
+    return false;
+}
+
+// Completes finished steps and sends as many further ones as the slots, barriers and
+// transmit queue allow
+static void Advance(void)
+{
+    while (status.state == CommandState_Running && nextStep < pipelineLength) {
+        const CommandStep *step = &pipeline[nextStep];
+
+        if (inFlightCount == COMMAND_MAX_IN_FLIGHT ||
+            ((step->flags & CommandFlag_Barrier) && inFlightCount != 0)) {
+            return;
+        }
+        if (!Send(nextStep)) {
+            return; // retried from CommandEngine_Poll once the queue drains
+        }
+        if (step->expect == NULL) {
+            status.completed++;
+        } else {
+            inFlight[inFlightCount].step = nextStep;
+            inFlight[inFlightCount].attemptsLeft = step->retries;
+            Track(&inFlight[inFlightCount], step, MonotonicMs());
+            inFlightCount++;
+        }
+        nextStep++;
+    }
+
+    if (status.state == CommandState_Running && nextStep == pipelineLength && inFlightCount == 0) {
+        Finish(CommandState_Done);
+    }
+}
+
+// Completes the oldest in-flight step expecting this sentence, and flags Absent
+// steps that should have stopped it; they are resent from CommandEngine_Poll
+static void MatchResponse(const char *body, size_t length)
+{
+    size_t match = COMMAND_MAX_IN_FLIGHT;
+
+    for (size_t slot = 0; slot < inFlightCount; slot++) {
+        InFlight *entry = &inFlight[slot];
+        const CommandStep *step = &pipeline[entry->step];
+        size_t expectLength = strlen(step->expect);
+
+        if (!entry->sent || lineStartMs < entry->countFromMs || expectLength > length ||
+            memcmp(body, step->expect, expectLength) != 0) {
+            continue;
+        }
+        if (step->flags & CommandFlag_Absent) {
+            entry->seen = true;
+            entry->deadlineMs = 0;
+        } else if (match == COMMAND_MAX_IN_FLIGHT || entry->step < inFlight[match].step) {
+            match = slot;
+        }
+    }
+    if (match != COMMAND_MAX_IN_FLIGHT) {
+        RemoveInFlight(match);
+        status.completed++;
+        Advance();
+    }
+}
+
+void CommandEngine_Start(UartTxQueue *tx, const CommandStep *steps, size_t count)
+{
+    memset(&status, 0, sizeof(status));
+    txQueue = tx;
+    pipeline = steps;
+    pipelineLength = count;
+    nextStep = 0;
+    inFlightCount = 0;
+    inSentence = false;
+    startMs = MonotonicMs();
+
+    status.state = CommandState_Running;
+    Advance();
+}
+
+void CommandEngine_Feed(const uint8_t *data, size_t length)
+{
+    if (status.state != CommandState_Running) {
+        return;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        char c = (char)data[i];
+
+        if (c == '$') {
+            lineStartMs = MonotonicMs();
+            MarkSent(lineStartMs);
+            inSentence = true;
+            lineLength = 0;
+        } else if (!inSentence) {
+            continue;
+        } else if (c == '\r' || c == '\n') {
+            // Needs "*hh" after a non-empty body
+            inSentence = false;
+            if (lineLength < 4 || line[lineLength - 3] != '*') {
+                continue;
+            }
+            int high = HexValue(line[lineLength - 2]);
+            int low = HexValue(line[lineLength - 1]);
+            size_t bodyLength = lineLength - 3;
+            if (high >= 0 && low >= 0 && Checksum(line, bodyLength) == (high << 4 | low)) {
+                MatchResponse(line, bodyLength);
+            }
+        } else if (lineLength < sizeof(line)) {
+            line[lineLength++] = c;
+        } else {
+            inSentence = false; // overlong, not NMEA
+        }
+    }
+}
+
+bool CommandEngine_Poll(void)
+{
+    if (status.state != CommandState_Running) {
+        return false;
+    }
+
+    int64_t now = MonotonicMs();
+    MarkSent(now);
+    for (size_t slot = 0; slot < inFlightCount && status.state == CommandState_Running;) {
+        InFlight *entry = &inFlight[slot];
+        const CommandStep *step = &pipeline[entry->step];
+
+        if (now < entry->deadlineMs) {
+            slot++;
+        } else if ((step->flags & CommandFlag_Absent) && entry->sent && !entry->seen) {
+            // Quiet for the whole timeout after the command went out
+            RemoveInFlight(slot);
+            status.completed++;
+        } else if (Retry(slot, now)) {
+            slot++;
+        }
+    }
+
+    Advance();
+    return status.state == CommandState_Running;
+}
+
+void CommandEngine_Stop(void)
+{
+    if (status.state == CommandState_Running) {
+        status.state = CommandState_Idle;
+        inFlightCount = 0;
+    }
+}
+
+CommandStatus CommandEngine_GetStatus(void)
+{
+    return status;
+}
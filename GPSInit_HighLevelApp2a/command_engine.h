@@ -0,0 +1,91 @@
+/* Licensed under the MIT License. */
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "uart_tx.h"
+
+/// <summary>
+/// <para>Asynchronous command/response engine for proprietary receiver sentences
+/// ($PSRF..., $PMTK...).</para>
+/// <para>A configuration sequence is declared as an array of CommandStep, the pipeline.
+/// Steps are sent in order, with up to COMMAND_MAX_IN_FLIGHT of them awaiting their
+/// response at once; a barrier step waits until everything before it has finished.
+/// A step completes when a checksum-valid sentence from the receiver starts with its
+/// expected text, e.g. "PMTK001,220,3" for an acknowledgement or "GPRMC" for a change
+/// that shows up in the output. Only sentences that began after the step left the
+/// transmit queue count, so output the receiver produced before it saw the command
+/// proves nothing. A step that turns output off is confirmed by absence instead: it
+/// completes once its sentence has not been seen for its timeout. Steps that time
+/// out, or whose supposedly disabled sentence still shows up, are resent up to their
+/// retry count.</para>
+/// <para>The engine never blocks: received bytes are passed to CommandEngine_Feed and
+/// CommandEngine_Poll is called from a timer to handle timeouts.</para>
+/// </summary>
+
+#define COMMAND_MAX_IN_FLIGHT 4
+
+typedef enum {
+    CommandFlag_Barrier = 1,    ///< wait for all earlier steps before sending this one
+    CommandFlag_Optional = 2,   ///< a timeout skips the step instead of failing the pipeline
+    CommandFlag_Absent = 4      ///< completes when expect is NOT seen for timeoutMs
+} CommandFlags;
+
+/// <summary>
+///     One step of a pipeline.
+/// </summary>
+typedef struct CommandStep {
+    const char *body;           ///< sentence between '$' and '*'; the checksum is added
+    const char *expect;         ///< response prefix completing the step, or NULL once sent
+    uint16_t timeoutMs;         ///< per attempt, from when the step left the transmit queue
+    uint8_t retries;            ///< resends after the first attempt
+    uint8_t flags;              ///< CommandFlags
+} CommandStep;
+
+typedef enum {
+    CommandState_Idle,
+    CommandState_Running,
+    CommandState_Done,          ///< every required step completed
+    CommandState_Failed         ///< a required step ran out of retries, or output failed
+} CommandState;
+
+typedef struct CommandStatus {
+    CommandState state;
+    size_t completed;           ///< steps completed
+    size_t skipped;             ///< optional steps that timed out
+    size_t failedStep;          ///< index of the step that failed the pipeline
+    unsigned int resends;       ///< retries over all steps
+    int64_t elapsedMs;          ///< from start until done or failed
+} CommandStatus;
+
+/// <summary>
+///     Starts running a pipeline. Any pipeline already running is abandoned.
+/// </summary>
+/// <param name="tx">Transmit queue of the UART connected to the receiver</param>
+/// <param name="steps">The pipeline; must stay valid while it runs</param>
+/// <param name="count">Number of steps</param>
+void CommandEngine_Start(UartTxQueue *tx, const CommandStep *steps, size_t count);
+
+/// <summary>
+///     Passes bytes received from the receiver to the engine, which frames them into
+///     sentences and completes matching steps.
+/// </summary>
+void CommandEngine_Feed(const uint8_t *data, size_t length);
+
+/// <summary>
+///     Handles timeouts and sends steps that could not be queued earlier.
+///     Call periodically while it returns true.
+/// </summary>
+/// <returns>true while the pipeline is running</returns>
+bool CommandEngine_Poll(void);
+
+/// <summary>
+///     Abandons the running pipeline, if any.
+/// </summary>
+void CommandEngine_Stop(void);
+
+/// <summary>
+///     Current pipeline state and progress.
+/// </summary>
+CommandStatus CommandEngine_GetStatus(void);
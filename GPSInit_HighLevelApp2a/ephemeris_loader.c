@@ -0,0 +1,370 @@
+/* Licensed under the MIT License. */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <applibs/log.h>
+#include <applibs/storage.h>
+#include "ephemeris_loader.h"
+#include "persistent_stats.h"
+
+#define EPHEMERIS_HEADER_SIZE 16
+#define EPHEMERIS_CHUNK_MAX 128
+
+// The stored copy follows the persistent stats record in the app's one mutable
+// storage file, which is MutableStorage SizeKB in app_manifest.json long
+#define EPHEMERIS_STORAGE_OFFSET PERSISTENT_STATS_STORAGE_SIZE
+#define EPHEMERIS_STORAGE_SIZE (64 * 1024)
+#define EPHEMERIS_PAYLOAD_MAX \
+    (EPHEMERIS_STORAGE_SIZE - EPHEMERIS_STORAGE_OFFSET - EPHEMERIS_HEADER_SIZE)
+
+// SiRF binary message 129, Switch To NMEA Protocol: start sequence, payload length,
+// payload, 15-bit checksum of the payload and end sequence
+#define SIRF_SWITCH_TO_NMEA_PAYLOAD 24
+#define SIRF_SWITCH_TO_NMEA_FRAME (4 + SIRF_SWITCH_TO_NMEA_PAYLOAD + 4)
+
+// Any wall clock earlier than this has not been set since boot, so the age of
+// the data cannot be judged
+#define EPHEMERIS_EARLIEST_CLOCK 1546300800 // 2019-01-01
+
+static void DefaultClose(int fd)
+{
+    close(fd);
+}
+
+static const EphemerisFileOps imagePackageOps = {
+    .open = Storage_OpenFileInImagePackage, .read = read, .close = DefaultClose};
+
+typedef struct EphemerisHeader {
+    uint32_t createdUtc;
+    uint32_t validSeconds;
+    uint32_t payloadLength;
+} EphemerisHeader;
+
+// Where a transfer in the Sending state is
+typedef enum {
+    Phase_EnterBinary,          ///< $PSRF100 not queued yet
+    Phase_Payload,
+    Phase_LeaveBinary           ///< payload queued, message 129 not queued yet
+} Phase;
+
+static int fileFd = -1;          ///< mutable storage, read at readOffset while sending
+static off_t readOffset;
+static UartTxQueue *txQueue;
+static EphemerisStatus status;
+static Phase phase;
+static uint32_t bitRate;
+
+static uint32_t ReadLe32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool ParseHeader(const uint8_t *raw, EphemerisHeader *header)
+{
+    if (memcmp(raw, "SGEE", 4) != 0) {
+        return false;
+    }
+    header->createdUtc = ReadLe32(raw + 4);
+    header->validSeconds = ReadLe32(raw + 8);
+    header->payloadLength = ReadLe32(raw + 12);
+    return true;
+}
+
+static ssize_t ReadFully(const EphemerisFileOps *ops, int fd, void *buffer, size_t length)
+{
+    size_t total = 0;
+    while (total < length) {
+        ssize_t n = ops->read(fd, (uint8_t *)buffer + total, length - total);
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        total += (size_t)n;
+    }
+    return (ssize_t)total;
+}
+
+static bool ReadStored(int fd, off_t offset, void *buffer, size_t length)
+{
+    return pread(fd, buffer, length, offset) == (ssize_t)length;
+}
+
+static bool WriteStored(int fd, off_t offset, const void *buffer, size_t length)
+{
+    return pwrite(fd, buffer, length, offset) == (ssize_t)length;
+}
+
+static int StoreFailed(void)
+{
+    Log_Debug("ERROR: Could not store ephemeris: %s (%d).\n", strerror(errno), errno);
+    return -1;
+}
+
+static bool ReadStoredHeader(int fd, EphemerisHeader *header)
+{
+    uint8_t raw[EPHEMERIS_HEADER_SIZE];
+    return ReadStored(fd, EPHEMERIS_STORAGE_OFFSET, raw, sizeof(raw)) && ParseHeader(raw, header) &&
+           header->payloadLength <= EPHEMERIS_PAYLOAD_MAX;
+}
+
+static void CloseFile(void)
+{
+    if (fileFd >= 0) {
+        close(fileFd);
+        fileFd = -1;
+    }
+}
+
+static int Reject(const char *reason)
+{
+    Log_Debug("Ephemeris rejected: %s\n", reason);
+    CloseFile();
+    status.state = EphemerisState_Rejected;
+    return -1;
+}
+
+// Queues $PSRF100 selecting the SiRF binary protocol at the current bit rate
+static int EnqueueEnterBinary(void)
+{
+    char body[32];
+    char sentence[sizeof(body) + 6];
+    uint8_t parity = 0;
+
+    int length = snprintf(body, sizeof(body), "PSRF100,0,%lu,8,1,0", (unsigned long)bitRate);
+    for (int i = 0; i < length; i++) {
+        parity ^= (uint8_t)body[i];
+    }
+    length = snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body, parity);
+    return UartTx_Enqueue(txQueue, sentence, (size_t)length);
+}
+
+// Queues binary message 129, returning to NMEA with GGA and RMC once a second and
+// everything else off, the same output the command pipeline configures
+static int EnqueueLeaveBinary(void)
+{
+    uint8_t frame[SIRF_SWITCH_TO_NMEA_FRAME] = {
+        0xA0, 0xA2, 0x00, SIRF_SWITCH_TO_NMEA_PAYLOAD,
+        0x81, 0x02,             // message 129, leave the debug setting alone
+        0x01, 0x01,             // GGA every second, with checksum
+        0x00, 0x01,             // GLL
+        0x00, 0x01,             // GSA
+        0x00, 0x01,             // GSV
+        0x01, 0x01,             // RMC every second, with checksum
+        0x00, 0x01,             // VTG
+        0x00, 0x01,             // MSS
+        0x00, 0x00,             // EPE, unused
+        0x00, 0x01,             // ZDA
+        0x00, 0x00,             // unused
+        (uint8_t)(bitRate >> 8), (uint8_t)bitRate,
+    };
+    uint16_t checksum = 0;
+
+    for (size_t i = 4; i < 4 + SIRF_SWITCH_TO_NMEA_PAYLOAD; i++) {
+        checksum = (uint16_t)((checksum + frame[i]) & 0x7FFF);
+    }
+    frame[4 + SIRF_SWITCH_TO_NMEA_PAYLOAD] = (uint8_t)(checksum >> 8);
+    frame[5 + SIRF_SWITCH_TO_NMEA_PAYLOAD] = (uint8_t)checksum;
+    frame[6 + SIRF_SWITCH_TO_NMEA_PAYLOAD] = 0xB0;
+    frame[7 + SIRF_SWITCH_TO_NMEA_PAYLOAD] = 0xB3;
+    return UartTx_Enqueue(txQueue, frame, sizeof(frame));
+}
+
+// Abandons a transfer after the switch to binary, switching back if the queue allows
+static bool Fail(void)
+{
+    CloseFile();
+    EnqueueLeaveBinary();
+    status.state = EphemerisState_Failed;
+    return false;
+}
+
+// Copies the payload after a header already read from source into mutable storage,
+// unless the stored copy is at least as new
+static int StoreIfNewer(const EphemerisFileOps *source, int sourceFd, const char *path,
+                        const uint8_t *raw, const EphemerisHeader *incoming, int storageFd)
+{
+    static const uint8_t cleared[EPHEMERIS_HEADER_SIZE];
+    uint8_t chunk[EPHEMERIS_CHUNK_MAX];
+    EphemerisHeader stored;
+
+    if (ReadStoredHeader(storageFd, &stored) && stored.createdUtc >= incoming->createdUtc) {
+        return 0;
+    }
+
+    // Clear the stored header first and write the new one last, so a copy cut short by
+    // a reset reads as missing rather than as valid data with a torn payload
+    if (!WriteStored(storageFd, EPHEMERIS_STORAGE_OFFSET, cleared, sizeof(cleared))) {
+        return StoreFailed();
+    }
+    for (uint32_t copied = 0; copied < incoming->payloadLength;) {
+        size_t length = incoming->payloadLength - copied;
+        if (length > sizeof(chunk)) {
+            length = sizeof(chunk);
+        }
+        if (ReadFully(source, sourceFd, chunk, length) != (ssize_t)length) {
+            Log_Debug("Ephemeris: %s truncated at %lu bytes\n", path, (unsigned long)copied);
+            return -1;
+        }
+        if (!WriteStored(storageFd, EPHEMERIS_STORAGE_OFFSET + EPHEMERIS_HEADER_SIZE + copied,
+                         chunk, length)) {
+            return StoreFailed();
+        }
+        copied += (uint32_t)length;
+    }
+    if (!WriteStored(storageFd, EPHEMERIS_STORAGE_OFFSET, raw, EPHEMERIS_HEADER_SIZE)) {
+        return StoreFailed();
+    }
+    Log_Debug("Ephemeris: stored %lu bytes from %s\n", (unsigned long)incoming->payloadLength,
+              path);
+    return 0;
+}
+
+int EphemerisLoader_Refresh(const EphemerisFileOps *source, const char *path)
+{
+    uint8_t raw[EPHEMERIS_HEADER_SIZE];
+    EphemerisHeader incoming;
+    int result = -1;
+
+    if (source == NULL) {
+        source = &imagePackageOps;
+    }
+    int sourceFd = source->open(path);
+    if (sourceFd < 0) {
+        Log_Debug("Ephemeris: no file at %s\n", path);
+        return -1;
+    }
+
+    if (ReadFully(source, sourceFd, raw, sizeof(raw)) != sizeof(raw) ||
+        !ParseHeader(raw, &incoming)) {
+        Log_Debug("Ephemeris: bad header in %s\n", path);
+    } else if (incoming.payloadLength > EPHEMERIS_PAYLOAD_MAX) {
+        Log_Debug("Ephemeris: %s is larger than mutable storage\n", path);
+    } else {
+        int storageFd = Storage_OpenMutableFile();
+        if (storageFd < 0) {
+            result = StoreFailed();
+        } else {
+            result = StoreIfNewer(source, sourceFd, path, raw, &incoming, storageFd);
+            close(storageFd);
+        }
+    }
+
+    source->close(sourceFd);
+    return result;
+}
+
+int EphemerisLoader_Start(UartTxQueue *tx, uint32_t maxAgeSeconds, uint32_t baudRate)
+{
+    EphemerisHeader header;
+
+    EphemerisLoader_Stop();
+    memset(&status, 0, sizeof(status));
+    txQueue = tx;
+    bitRate = baudRate;
+
+    fileFd = Storage_OpenMutableFile();
+    if (fileFd < 0) {
+        return Reject("no mutable storage");
+    }
+    if (!ReadStoredHeader(fileFd, &header)) {
+        return Reject("nothing stored");
+    }
+    readOffset = EPHEMERIS_STORAGE_OFFSET + EPHEMERIS_HEADER_SIZE;
+
+    uint32_t createdUtc = header.createdUtc;
+    uint32_t validSeconds = header.validSeconds;
+    status.payloadLength = header.payloadLength;
+
+    time_t now = time(NULL);
+    if (now < EPHEMERIS_EARLIEST_CLOCK) {
+        return Reject("clock not set, age unknown");
+    }
+    if ((uint64_t)now < createdUtc) {
+        return Reject("created in the future");
+    }
+    status.ageSeconds = (uint32_t)((uint64_t)now - createdUtc);
+    if (status.ageSeconds > maxAgeSeconds || status.ageSeconds >= validSeconds) {
+        return Reject("too old");
+    }
+
+    status.state = EphemerisState_Sending;
+    phase = Phase_EnterBinary;
+    Log_Debug("Ephemeris: sending %lu bytes, %lu s old\n", (unsigned long)status.payloadLength,
+              (unsigned long)status.ageSeconds);
+    return 0;
+}
+
+bool EphemerisLoader_Pump(size_t chunkSize)
+{
+    uint8_t chunk[EPHEMERIS_CHUNK_MAX];
+
+    if (status.state != EphemerisState_Sending) {
+        return false;
+    }
+
+    // The receiver switches protocol once the whole sentence is in, well before the
+    // next tick, so the payload can follow on the next call
+    if (phase == Phase_EnterBinary) {
+        if (EnqueueEnterBinary() == 0) {
+            phase = Phase_Payload;
+        }
+        return true; // a full queue just delays the switch to the next tick
+    }
+    if (phase == Phase_LeaveBinary) {
+        if (EnqueueLeaveBinary() != 0) {
+            return true;
+        }
+        status.state = EphemerisState_Done;
+        Log_Debug("Ephemeris: sent\n");
+        return false;
+    }
+
+    size_t remaining = status.payloadLength - status.bytesSent;
+    if (chunkSize > sizeof(chunk)) {
+        chunkSize = sizeof(chunk);
+    }
+    if (chunkSize > remaining) {
+        chunkSize = remaining;
+    }
+    if (UartTx_Free(txQueue) < chunkSize) {
+        return true; // other output still draining, retry next time
+    }
+
+    if (!ReadStored(fileFd, readOffset, chunk, chunkSize)) {
+        Log_Debug("ERROR: Stored ephemeris truncated at %lu bytes\n", (unsigned long)status.bytesSent);
+        return Fail();
+    }
+    readOffset += (off_t)chunkSize;
+    if (UartTx_Enqueue(txQueue, chunk, chunkSize) != 0) {
+        return Fail();
+    }
+    status.bytesSent += (uint32_t)chunkSize;
+
+    if (status.bytesSent >= status.payloadLength) {
+        CloseFile();
+        phase = Phase_LeaveBinary;
+    }
+    return true;
+}
+
+void EphemerisLoader_Stop(void)
+{
+    CloseFile();
+    if (status.state == EphemerisState_Sending) {
+        // Best effort: without the switch back the receiver stays silent in binary
+        if (phase != Phase_EnterBinary) {
+            EnqueueLeaveBinary();
+        }
+        status.state = EphemerisState_Idle;
+    }
+}
+
+EphemerisStatus EphemerisLoader_GetStatus(void)
+{
+    return status;
+}
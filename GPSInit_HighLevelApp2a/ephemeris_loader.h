@@ -0,0 +1,90 @@
+/* Licensed under the MIT License. */
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "uart_tx.h"
+
+/// <summary>
+/// <para>Extended ephemeris (SiRF CGEE/SGEE) aiding for faster time to first fix.</para>
+/// <para>The ephemeris file is prepared off-device: a 16-byte header followed by the
+/// payload exactly as it is to be sent to the receiver. Header fields are little-endian:
+///   char magic[4] = "SGEE", uint32 createdUtc (Unix seconds),
+///   uint32 validSeconds, uint32 payloadLength.</para>
+/// <para>The data is only valid for a few days, so it is sent from a copy in mutable
+/// storage, after the persistent stats record, that Refresh replaces whenever it is
+/// given a newer file: the copy in the image package seeds it, and a downloader can
+/// supply fresh files without the app being redeployed.</para>
+/// <para>SiRF receivers only take SGEE data in their binary protocol, so the transfer is
+/// framed by protocol switches: $PSRF100 moves the receiver from NMEA to binary, the
+/// payload follows in small chunks paced by a timer, since the UART has no hardware
+/// flow control, and binary message 129 returns it to NMEA with only GGA and RMC
+/// enabled. The receiver's binary acknowledgements are not parsed, so Done means the
+/// data was sent, not that the receiver accepted it.</para>
+/// </summary>
+
+/// <summary>
+///     Read access to a source of ephemeris files for Refresh, e.g. the image package
+///     or wherever a downloader keeps what it fetched.
+/// </summary>
+typedef struct EphemerisFileOps {
+    int (*open)(const char *path);
+    ssize_t (*read)(int fd, void *buffer, size_t length);
+    void (*close)(int fd);
+} EphemerisFileOps;
+
+typedef enum {
+    EphemerisState_Idle,
+    EphemerisState_Sending,
+    EphemerisState_Done,        ///< whole payload and the switch back to NMEA queued
+    EphemerisState_Rejected,    ///< nothing stored, or too old
+    EphemerisState_Failed       ///< I/O error while sending
+} EphemerisState;
+
+typedef struct EphemerisStatus {
+    EphemerisState state;
+    uint32_t ageSeconds;        ///< age of the data when validated
+    uint32_t payloadLength;
+    uint32_t bytesSent;
+} EphemerisStatus;
+
+/// <summary>
+///     Copies an ephemeris file into mutable storage if it was created later than the
+///     stored copy. Do not call while a transfer is in progress.
+/// </summary>
+/// <param name="source">Where to read the file, or NULL for the image package</param>
+/// <param name="path">Path of the file within the source</param>
+/// <returns>0 if the stored copy is now at least as new as the file, or -1 if the file
+/// is missing, malformed or too large, or storage could not be written</returns>
+int EphemerisLoader_Refresh(const EphemerisFileOps *source, const char *path);
+
+/// <summary>
+///     Validates the copy in mutable storage and prepares to stream it to the receiver.
+/// </summary>
+/// <param name="tx">Transmit queue of the UART connected to the receiver</param>
+/// <param name="maxAgeSeconds">Oldest data accepted, measured from createdUtc</param>
+/// <param name="baudRate">UART bit rate, kept across both protocol switches</param>
+/// <returns>0 if streaming can start, or -1 if the stored copy was rejected</returns>
+int EphemerisLoader_Start(UartTxQueue *tx, uint32_t maxAgeSeconds, uint32_t baudRate);
+
+/// <summary>
+///     Queues the next step of the transfer: the switch to binary, a chunk of the payload
+///     or the switch back to NMEA. Call periodically while it returns true. If the
+///     transmit queue lacks room for the whole step, nothing is queued this time.
+/// </summary>
+/// <param name="chunkSize">Most bytes to queue in this call</param>
+/// <returns>true while there is more to send</returns>
+bool EphemerisLoader_Pump(size_t chunkSize);
+
+/// <summary>
+///     Stops any transfer in progress and closes the file. A receiver already switched
+///     to binary is switched back to NMEA.
+/// </summary>
+void EphemerisLoader_Stop(void);
+
+/// <summary>
+///     Current transfer state and progress.
+/// </summary>
+EphemerisStatus EphemerisLoader_GetStatus(void);
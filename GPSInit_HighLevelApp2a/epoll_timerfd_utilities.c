@@ -135,6 +135,7 @@ int WaitForEventAndCallHandler(int epollFd)
 
     if (numEventsOccurred == 1 && event.data.ptr != NULL) {
         EventData *eventData = event.data.ptr;
+        eventData->events = event.events;
         eventData->eventHandler(eventData);
     }
 
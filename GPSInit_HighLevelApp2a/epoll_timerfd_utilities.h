@@ -31,6 +31,10 @@ typedef struct EventData {
     /// The file descriptor that generated the event.
     /// </summary>
     int fd;
+    /// <summary>
+    /// The epoll events (EPOLLIN, EPOLLOUT, ...) that triggered the current call.
+    /// </summary>
+    uint32_t events;
 } EventData;
 
 /// <summary>
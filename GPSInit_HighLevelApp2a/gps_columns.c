@@ -0,0 +1,700 @@
+/*
+gps_columns - columnar export of parsed fixes. See gps_columns.h.
+*/
+
+#include <string.h>
+#include "gps_columns.h"
+#include "gps_geo.h"
+
+static const byte file_magic[8] = { 'G', 'P', 'S', 'C', 'O', 'L', 'S', '1' };
+static const byte batch_magic[4] = { 'B', 'T', 'C', 'H' };
+
+#define SIGNED 0x80
+#define ALIGN8(n) (((n) + 7) & ~(size_t)7)
+#define BATCH_PREFIX (GPS_COLUMNS_BATCH_HEADER_SIZE + GPS_COLUMNS_ZONE_SIZE + GPS_COL_COUNT * GPS_COLUMNS_DESC_SIZE)
+
+static const struct {
+  char name[14];
+  byte type;                         // width | SIGNED
+  size_t offset;                     // of the writer's array
+} column_info[GPS_COL_COUNT] = {
+  [GPS_COL_TIME]       = { "time_ms",     8 | SIGNED, offsetof(gps_columns_writer, _time) },
+  [GPS_COL_LATITUDE]   = { "lat_e7",      4 | SIGNED, offsetof(gps_columns_writer, _latitude) },
+  [GPS_COL_LONGITUDE]  = { "lon_e7",      4 | SIGNED, offsetof(gps_columns_writer, _longitude) },
+  [GPS_COL_SPEED]      = { "speed_cknot", 4,          offsetof(gps_columns_writer, _speed) },
+  [GPS_COL_COURSE]     = { "course_cdeg", 4,          offsetof(gps_columns_writer, _course) },
+  [GPS_COL_ALTITUDE]   = { "alt_cm",      4 | SIGNED, offsetof(gps_columns_writer, _altitude) },
+  [GPS_COL_HDOP]       = { "hdop_c",      2,          offsetof(gps_columns_writer, _hdop) },
+  [GPS_COL_SATELLITES] = { "satellites",  1,          offsetof(gps_columns_writer, _satellites) },
+  [GPS_COL_QUALITY]    = { "quality",     1,          offsetof(gps_columns_writer, _quality) },
+};
+
+static byte width_of(int column)
+{
+  return column_info[column].type & ~SIGNED;
+}
+
+static byte *put_le(byte *p, uint64_t value, int width)
+{
+  while (width-- > 0)
+  {
+    *p++ = (byte)value;
+    value >>= 8;
+  }
+  return p;
+}
+
+static int64_t get_le(const byte *p, int width, bool is_signed)
+{
+  uint64_t value = 0;
+  int i;
+
+  for (i = width - 1; i >= 0; --i)
+    value = value << 8 | p[i];
+  if (is_signed && width < 8 && (value >> (8 * width - 1) & 1))
+    value |= ~(uint64_t)0 << (8 * width);
+  return (int64_t)value;
+}
+
+// ---- writer ----
+
+void gps_columns_init(gps_columns_writer *w)
+{
+  memset(w, 0, sizeof(*w));
+}
+
+static int64_t value_at(const gps_columns_writer *w, int column, size_t row)
+{
+  const byte *p = (const byte *)w + column_info[column].offset;
+
+  switch (column_info[column].type)
+  {
+  case 1: return ((const uint8_t *)p)[row];
+  case 2: return ((const uint16_t *)p)[row];
+  case 4: return ((const uint32_t *)p)[row];
+  case 4 | SIGNED: return ((const int32_t *)p)[row];
+  default: return ((const int64_t *)p)[row];
+  }
+}
+
+static void set_value(gps_columns_writer *w, int column, size_t row, int64_t value)
+{
+  byte *p = (byte *)w + column_info[column].offset;
+
+  switch (column_info[column].type)
+  {
+  case 1: ((uint8_t *)p)[row] = (uint8_t)value; break;
+  case 2: ((uint16_t *)p)[row] = (uint16_t)value; break;
+  case 4: ((uint32_t *)p)[row] = (uint32_t)value; break;
+  case 4 | SIGNED: ((int32_t *)p)[row] = (int32_t)value; break;
+  default: ((int64_t *)p)[row] = value; break;
+  }
+}
+
+static bool is_set(const byte *bitmap, size_t row)
+{
+  return bitmap[row >> 3] >> (row & 7) & 1;
+}
+
+// bit of the k-th Bloom probe for a geohash cell
+static unsigned bloom_bit(uint64_t cell, int k)
+{
+  uint64_t h = cell * 0x9E3779B97F4A7C15ULL;
+  uint32_t h1 = (uint32_t)(h >> 32), h2 = (uint32_t)h | 1;
+  return (h1 + (uint32_t)k * h2) & (GPS_COLUMNS_BLOOM_BITS - 1);
+}
+
+// a null repeats the previous value so that deltas and dictionaries stay small
+static void store(gps_columns_writer *w, int column, bool valid, int64_t value)
+{
+  size_t row = w->_rows;
+
+  if (valid)
+    w->_valid[column][row >> 3] |= (byte)(1 << (row & 7));
+  else
+    value = row > 0 ? value_at(w, column, row - 1) : 0;
+  set_value(w, column, row, value);
+}
+
+static int flush(gps_columns_writer *w, gps_columns_sink sink, void *ctx)
+{
+  if (w->_out_len != 0 && sink(ctx, w->_out, w->_out_len) != 0)
+    return -1;
+  w->_out_len = 0;
+  return 0;
+}
+
+// room for n more staged bytes, n <= sizeof(_out)
+static byte *reserve(gps_columns_writer *w, size_t n, gps_columns_sink sink, void *ctx)
+{
+  if (w->_out_len + n > sizeof(w->_out) && flush(w, sink, ctx) != 0)
+    return NULL;
+  w->_offset += n;
+  w->_out_len += n;
+  return w->_out + w->_out_len - n;
+}
+
+static int emit(gps_columns_writer *w, const void *data, size_t len, gps_columns_sink sink, void *ctx)
+{
+  const byte *p = data;
+
+  while (len > 0)
+  {
+    size_t take = len < sizeof(w->_out) ? len : sizeof(w->_out);
+    byte *dst = reserve(w, take, sink, ctx);
+    if (dst == NULL)
+      return -1;
+    memcpy(dst, p, take);
+    p += take;
+    len -= take;
+  }
+  return 0;
+}
+
+static int emit_le(gps_columns_writer *w, uint64_t value, int width, gps_columns_sink sink, void *ctx)
+{
+  byte *dst = reserve(w, (size_t)width, sink, ctx);
+  if (dst == NULL)
+    return -1;
+  put_le(dst, value, width);
+  return 0;
+}
+
+static int pad(gps_columns_writer *w, gps_columns_sink sink, void *ctx)
+{
+  static const byte zeros[8];
+  return emit(w, zeros, ALIGN8(w->_offset) - w->_offset, sink, ctx);
+}
+
+static int write_header(gps_columns_writer *w, gps_columns_sink sink, void *ctx)
+{
+  byte header[GPS_COLUMNS_HEADER_SIZE + GPS_COL_COUNT * GPS_COLUMNS_SCHEMA_SIZE];
+  byte *p = header;
+  int c;
+
+  memcpy(p, file_magic, sizeof(file_magic));
+  p = put_le(p + sizeof(file_magic), GPS_COLUMNS_VERSION, 2);
+  p = put_le(p, GPS_COL_COUNT, 2);
+  p = put_le(p, GPS_COLUMNS_BATCH, 4);
+  for (c = 0; c < GPS_COL_COUNT; ++c)
+  {
+    *p++ = column_info[c].type;
+    *p++ = 0;
+    memcpy(p, column_info[c].name, sizeof(column_info[c].name));
+    p += sizeof(column_info[c].name);
+  }
+  w->_started = true;
+  return emit(w, header, sizeof(header), sink, ctx);
+}
+
+// index of value in the dictionary being built, adding it if there is
+// room; -1 once the column has too many distinct values
+static int dict_index(gps_columns_writer *w, unsigned short *count, int64_t value)
+{
+  unsigned slot = (unsigned)(((uint64_t)value * 0x9E3779B97F4A7C15ULL) >> 40) & (2 * GPS_COLUMNS_DICT_MAX - 1);
+
+  while (w->_dict_slots[slot] != 0)
+  {
+    if (w->_dict[w->_dict_slots[slot] - 1] == value)
+      return w->_dict_slots[slot] - 1;
+    slot = (slot + 1) & (2 * GPS_COLUMNS_DICT_MAX - 1);
+  }
+  if (*count == GPS_COLUMNS_DICT_MAX)
+    return -1;
+  w->_dict[*count] = value;
+  w->_dict_slots[slot] = (short)++*count;
+  return *count - 1;
+}
+
+static void dict_reset(gps_columns_writer *w)
+{
+  memset(w->_dict_slots, 0, sizeof(w->_dict_slots));
+}
+
+static byte delta_width(int64_t lo, int64_t hi)
+{
+  if (lo == 0 && hi == 0)
+    return 0;
+  if (lo >= INT8_MIN && hi <= INT8_MAX)
+    return 1;
+  if (lo >= INT16_MIN && hi <= INT16_MAX)
+    return 2;
+  if (lo >= INT32_MIN && hi <= INT32_MAX)
+    return 4;
+  return 8;
+}
+
+typedef struct column_plan {
+  byte encoding, width;
+  unsigned short dict_count;
+  unsigned long null_count;
+  size_t validity, dict, data, data_len;  // offsets within the batch
+} column_plan;
+
+// choose the smallest encoding for one column of the current batch
+static void plan_column(gps_columns_writer *w, int column, column_plan *plan)
+{
+  size_t rows = w->_rows, i;
+  byte width = width_of(column);
+  size_t plain = rows * width, delta, dict = (size_t)-1;
+  int64_t lo = 0, hi = 0, prev = value_at(w, column, 0);
+  unsigned short count = 0;
+
+  for (i = 1; i < rows; ++i)
+  {
+    int64_t v = value_at(w, column, i), d = (int64_t)((uint64_t)v - (uint64_t)prev);
+    if (d < lo)
+      lo = d;
+    if (d > hi)
+      hi = d;
+    prev = v;
+  }
+  plan->width = delta_width(lo, hi);
+  delta = (rows - 1) * plan->width;
+
+  dict_reset(w);
+  for (i = 0; i < rows && dict_index(w, &count, value_at(w, column, i)) >= 0; ++i)
+    ;
+  if (i == rows)
+    dict = ALIGN8(count * width) + rows;
+
+  plan->dict_count = 0;
+  if (dict < plain && dict < delta)
+  {
+    plan->encoding = GPS_ENC_DICT;
+    plan->width = 1;
+    plan->dict_count = count;
+    plan->data_len = rows;
+  }
+  else if (delta < plain)
+  {
+    plan->encoding = GPS_ENC_DELTA;
+    plan->data_len = delta;
+  }
+  else
+  {
+    plan->encoding = GPS_ENC_PLAIN;
+    plan->width = width;
+    plan->data_len = plain;
+  }
+}
+
+static int write_column(gps_columns_writer *w, int column, const column_plan *plan,
+  gps_columns_sink sink, void *ctx)
+{
+  size_t rows = w->_rows, i;
+  byte width = width_of(column);
+  unsigned short count = 0;
+
+  if (plan->null_count != 0 &&
+      (emit(w, w->_valid[column], (rows + 7) / 8, sink, ctx) != 0 || pad(w, sink, ctx) != 0))
+    return -1;
+
+  if (plan->encoding == GPS_ENC_DICT)
+  {
+    dict_reset(w);
+    for (i = 0; i < rows; ++i)
+      dict_index(w, &count, value_at(w, column, i));
+    for (i = 0; i < count; ++i)
+      if (emit_le(w, (uint64_t)w->_dict[i], width, sink, ctx) != 0)
+        return -1;
+    if (pad(w, sink, ctx) != 0)
+      return -1;
+    for (i = 0; i < rows; ++i)
+      if (emit_le(w, (uint64_t)dict_index(w, &count, value_at(w, column, i)), 1, sink, ctx) != 0)
+        return -1;
+  }
+  else if (plan->encoding == GPS_ENC_DELTA)
+  {
+    for (i = 1; i < rows; ++i)
+      if (emit_le(w, (uint64_t)value_at(w, column, i) - (uint64_t)value_at(w, column, i - 1),
+            plan->width, sink, ctx) != 0)
+        return -1;
+  }
+  else
+  {
+    for (i = 0; i < rows; ++i)
+      if (emit_le(w, (uint64_t)value_at(w, column, i), width, sink, ctx) != 0)
+        return -1;
+  }
+  return pad(w, sink, ctx);
+}
+
+// zone map of the current batch, from the valid rows only
+static byte *put_zone(const gps_columns_writer *w, byte *p)
+{
+  int64_t min_time = INT64_MAX, max_time = INT64_MIN;
+  int32_t min_lat = INT32_MAX, max_lat = INT32_MIN, min_lon = INT32_MAX, max_lon = INT32_MIN;
+  byte bloom[GPS_COLUMNS_BLOOM_BITS / 8] = { 0 };
+  uint64_t last_cell = 0;
+  bool any_cell = false;
+  size_t i;
+  int k;
+
+  for (i = 0; i < w->_rows; ++i)
+  {
+    if (is_set(w->_valid[GPS_COL_TIME], i))
+    {
+      if (w->_time[i] < min_time)
+        min_time = w->_time[i];
+      if (w->_time[i] > max_time)
+        max_time = w->_time[i];
+    }
+    if (is_set(w->_valid[GPS_COL_LATITUDE], i))
+    {
+      int32_t lat = w->_latitude[i], lon = w->_longitude[i];
+      uint64_t cell = gps_geohash(lat, lon, GPS_COLUMNS_GEOHASH_CHARS);
+
+      if (lat < min_lat)
+        min_lat = lat;
+      if (lat > max_lat)
+        max_lat = lat;
+      if (lon < min_lon)
+        min_lon = lon;
+      if (lon > max_lon)
+        max_lon = lon;
+      // consecutive fixes mostly share a cell
+      if (!any_cell || cell != last_cell)
+        for (k = 0; k < GPS_COLUMNS_BLOOM_HASHES; ++k)
+          bloom[bloom_bit(cell, k) >> 3] |= (byte)(1 << (bloom_bit(cell, k) & 7));
+      last_cell = cell;
+      any_cell = true;
+    }
+  }
+
+  p = put_le(p, (uint64_t)min_time, 8);
+  p = put_le(p, (uint64_t)max_time, 8);
+  p = put_le(p, (uint64_t)min_lat, 4);
+  p = put_le(p, (uint64_t)max_lat, 4);
+  p = put_le(p, (uint64_t)min_lon, 4);
+  p = put_le(p, (uint64_t)max_lon, 4);
+  *p++ = GPS_COLUMNS_GEOHASH_CHARS;
+  *p++ = GPS_COLUMNS_BLOOM_HASHES;
+  p = put_le(p, GPS_COLUMNS_BLOOM_BITS, 2);
+  p = put_le(p, 0, 4);
+  memcpy(p, bloom, sizeof(bloom));
+  return p + sizeof(bloom);
+}
+
+static int write_batch(gps_columns_writer *w, gps_columns_sink sink, void *ctx)
+{
+  column_plan plans[GPS_COL_COUNT];
+  byte prefix[BATCH_PREFIX];
+  size_t rows = w->_rows, length = BATCH_PREFIX, i;
+  byte *p;
+  int c;
+
+  if (rows == 0)
+    return 0;
+
+  for (c = 0; c < GPS_COL_COUNT; ++c)
+  {
+    column_plan *plan = &plans[c];
+    size_t first = rows;
+
+    plan->null_count = 0;
+    for (i = 0; i < rows; ++i)
+      if (!is_set(w->_valid[c], i))
+        ++plan->null_count;
+      else if (first == rows)
+        first = i;
+    // leading nulls take the first real value rather than 0
+    for (i = 0; i < first && first < rows; ++i)
+      set_value(w, c, i, value_at(w, c, first));
+
+    plan_column(w, c, plan);
+    plan->validity = 0;
+    if (plan->null_count != 0)
+    {
+      plan->validity = length;
+      length += ALIGN8((rows + 7) / 8);
+    }
+    plan->dict = length;
+    length += ALIGN8(plan->dict_count * width_of(c));
+    plan->data = length;
+    length += ALIGN8(plan->data_len);
+  }
+
+  p = prefix;
+  memcpy(p, batch_magic, sizeof(batch_magic));
+  p = put_le(p + sizeof(batch_magic), rows, 4);
+  p = put_le(p, length, 4);
+  p = put_le(p, 0, 4);
+  p = put_zone(w, p);
+  for (c = 0; c < GPS_COL_COUNT; ++c)
+  {
+    const column_plan *plan = &plans[c];
+    *p++ = plan->encoding;
+    *p++ = plan->width;
+    p = put_le(p, plan->dict_count, 2);
+    p = put_le(p, plan->null_count, 4);
+    p = put_le(p, (uint64_t)value_at(w, c, 0), 8);
+    p = put_le(p, plan->validity, 4);
+    p = put_le(p, plan->dict, 4);
+    p = put_le(p, plan->data, 4);
+    p = put_le(p, plan->data_len, 4);
+  }
+  if (emit(w, prefix, sizeof(prefix), sink, ctx) != 0)
+    return -1;
+  for (c = 0; c < GPS_COL_COUNT; ++c)
+    if (write_column(w, c, &plans[c], sink, ctx) != 0)
+      return -1;
+
+  w->_rows = 0;
+  memset(w->_valid, 0, sizeof(w->_valid));
+  w->_batches++;
+  return flush(w, sink, ctx);
+}
+
+int gps_columns_add(gps_columns_writer *w, const gps_fix *fix, gps_columns_sink sink, void *ctx)
+{
+  int64_t ms = 0;
+  bool dated = gps_fix_time_ms(fix, &ms), position = fix->latitude != GPS_INVALID_ANGLE;
+
+  if (!w->_started && write_header(w, sink, ctx) != 0)
+    return -1;
+
+  store(w, GPS_COL_TIME, dated, ms);
+  store(w, GPS_COL_LATITUDE, position, fix->latitude);
+  store(w, GPS_COL_LONGITUDE, position, fix->longitude);
+  store(w, GPS_COL_SPEED, fix->speed != GPS_INVALID_SPEED, fix->speed);
+  store(w, GPS_COL_COURSE, fix->course != GPS_INVALID_ANGLE, fix->course);
+  store(w, GPS_COL_ALTITUDE, fix->altitude != GPS_INVALID_ALTITUDE, fix->altitude);
+  store(w, GPS_COL_HDOP, fix->hdop <= 0xFFFF, fix->hdop);
+  store(w, GPS_COL_SATELLITES, fix->numsats < GPS_INVALID_SATELLITES, fix->numsats);
+  store(w, GPS_COL_QUALITY, fix->quality != GPS_INVALID_QUALITY, fix->quality);
+
+  if (++w->_rows == GPS_COLUMNS_BATCH)
+    return write_batch(w, sink, ctx);
+  return 0;
+}
+
+int gps_columns_add_nmea(gps_columns_writer *w, gps_parser *gps, const char *buf, size_t len,
+  gps_columns_sink sink, void *ctx)
+{
+  size_t i;
+
+  for (i = 0; i < len; ++i)
+  {
+    gps_fix fix;
+
+    if (!gps_encode_r(gps, buf[i]))
+      continue;
+    gps_get_fix_r(gps, &fix);
+    // RMC and GGA of one epoch land in the same row
+    if (w->_epoch_open && fix.time != w->_epoch.time &&
+        gps_columns_add(w, &w->_epoch, sink, ctx) != 0)
+      return -1;
+    w->_epoch = fix;
+    w->_epoch_open = true;
+  }
+  return 0;
+}
+
+int gps_columns_finish(gps_columns_writer *w, gps_columns_sink sink, void *ctx)
+{
+  byte end[GPS_COLUMNS_BATCH_HEADER_SIZE] = { 0 };
+
+  if (w->_epoch_open)
+  {
+    w->_epoch_open = false;
+    if (gps_columns_add(w, &w->_epoch, sink, ctx) != 0)
+      return -1;
+  }
+  if (!w->_started && write_header(w, sink, ctx) != 0)
+    return -1;
+  if (write_batch(w, sink, ctx) != 0)
+    return -1;
+  memcpy(end, batch_magic, sizeof(batch_magic));
+  put_le(end + sizeof(batch_magic) + 4, sizeof(end), 4);
+  if (emit(w, end, sizeof(end), sink, ctx) != 0)
+    return -1;
+  return flush(w, sink, ctx);
+}
+
+// ---- reader ----
+
+int gps_columns_open(const void *file, size_t len, size_t *offset)
+{
+  const byte *p = file;
+  size_t schema = GPS_COLUMNS_HEADER_SIZE + GPS_COL_COUNT * GPS_COLUMNS_SCHEMA_SIZE;
+  int c;
+
+  if (len < schema || memcmp(p, file_magic, sizeof(file_magic)) != 0 ||
+      get_le(p + 8, 2, false) != GPS_COLUMNS_VERSION || get_le(p + 10, 2, false) != GPS_COL_COUNT)
+    return -1;
+  for (c = 0; c < GPS_COL_COUNT; ++c)
+    if (p[GPS_COLUMNS_HEADER_SIZE + c * GPS_COLUMNS_SCHEMA_SIZE] != column_info[c].type)
+      return -1;
+  *offset = schema;
+  return 0;
+}
+
+// whether [at, at + n) lies inside a batch of length bytes
+static bool inside(size_t at, size_t n, size_t length)
+{
+  return at <= length && n <= length - at;
+}
+
+// Checks the batch header at offset. Returns 1 with the row count and
+// length of a batch, 0 at the end marker, or -1
+static int batch_header(const void *file, size_t len, size_t offset, size_t *rows, size_t *length)
+{
+  const byte *base = (const byte *)file + offset;
+
+  if (offset > len || len - offset < GPS_COLUMNS_BATCH_HEADER_SIZE ||
+      memcmp(base, batch_magic, sizeof(batch_magic)) != 0)
+    return -1;
+  *rows = (size_t)get_le(base + 4, 4, false);
+  *length = (size_t)get_le(base + 8, 4, false);
+  if (*rows == 0)
+    return 0;
+  if (*length > len - offset || *length % 8 != 0 || *length < BATCH_PREFIX)
+    return -1;
+  return 1;
+}
+
+static int read_zone(const byte *p, size_t rows, gps_columns_zone *zone)
+{
+  zone->rows = rows;
+  zone->min_time = get_le(p, 8, true);
+  zone->max_time = get_le(p + 8, 8, true);
+  zone->min_latitude = (long)get_le(p + 16, 4, true);
+  zone->max_latitude = (long)get_le(p + 20, 4, true);
+  zone->min_longitude = (long)get_le(p + 24, 4, true);
+  zone->max_longitude = (long)get_le(p + 28, 4, true);
+  zone->geohash_chars = p[32];
+  if (zone->geohash_chars == 0 || zone->geohash_chars > GPS_GEOHASH_MAX_CHARS ||
+      p[33] != GPS_COLUMNS_BLOOM_HASHES || get_le(p + 34, 2, false) != GPS_COLUMNS_BLOOM_BITS)
+    return -1;
+  memcpy(zone->bloom, p + 40, sizeof(zone->bloom));
+  return 0;
+}
+
+int gps_columns_next_zone(const void *file, size_t len, size_t *offset, gps_columns_zone *zone)
+{
+  size_t rows, length;
+  int found = batch_header(file, len, *offset, &rows, &length);
+
+  if (found <= 0)
+  {
+    if (found == 0)
+      *offset += GPS_COLUMNS_BATCH_HEADER_SIZE;
+    return found;
+  }
+  if (read_zone((const byte *)file + *offset + GPS_COLUMNS_BATCH_HEADER_SIZE, rows, zone) != 0)
+    return -1;
+  *offset += length;
+  return 1;
+}
+
+bool gps_columns_may_visit(const gps_columns_zone *zone, uint64_t cell)
+{
+  int k;
+
+  for (k = 0; k < GPS_COLUMNS_BLOOM_HASHES; ++k)
+  {
+    unsigned bit = bloom_bit(cell, k);
+    if (!(zone->bloom[bit >> 3] >> (bit & 7) & 1))
+      return false;
+  }
+  return true;
+}
+
+int gps_columns_next(const void *file, size_t len, size_t *offset, gps_columns_batch *batch)
+{
+  const byte *base = (const byte *)file + *offset, *p;
+  size_t rows, length;
+  int c, found = batch_header(file, len, *offset, &rows, &length);
+
+  if (found <= 0)
+  {
+    if (found == 0)
+      *offset += GPS_COLUMNS_BATCH_HEADER_SIZE;
+    return found;
+  }
+  if (read_zone(base + GPS_COLUMNS_BATCH_HEADER_SIZE, rows, &batch->zone) != 0)
+    return -1;
+
+  batch->rows = rows;
+  p = base + GPS_COLUMNS_BATCH_HEADER_SIZE + GPS_COLUMNS_ZONE_SIZE;
+  for (c = 0; c < GPS_COL_COUNT; ++c, p += GPS_COLUMNS_DESC_SIZE)
+  {
+    gps_columns_column *col = &batch->columns[c];
+    byte width = width_of(c);
+    size_t validity = (size_t)get_le(p + 16, 4, false);
+    size_t dict = (size_t)get_le(p + 20, 4, false);
+    size_t data = (size_t)get_le(p + 24, 4, false), i;
+
+    col->encoding = p[0];
+    col->width = p[1];
+    col->dict_count = (unsigned short)get_le(p + 2, 2, false);
+    col->null_count = (unsigned long)get_le(p + 4, 4, false);
+    col->base = get_le(p + 8, 8, true);
+    col->data_len = (size_t)get_le(p + 28, 4, false);
+    col->validity = col->null_count != 0 ? base + validity : NULL;
+    col->dict = base + dict;
+    col->data = base + data;
+
+    if (col->null_count > rows ||
+        (col->null_count != 0 && !inside(validity, (rows + 7) / 8, length)) ||
+        !inside(data, col->data_len, length))
+      return -1;
+    switch (col->encoding)
+    {
+    case GPS_ENC_PLAIN:
+      if (col->width != width || col->data_len != rows * width)
+        return -1;
+      break;
+    case GPS_ENC_DELTA:
+      if ((col->width != 0 && col->width != 1 && col->width != 2 && col->width != 4 && col->width != 8) ||
+          col->data_len != (rows - 1) * col->width)
+        return -1;
+      break;
+    case GPS_ENC_DICT:
+      if (col->width != 1 || col->data_len != rows || col->dict_count == 0 ||
+          col->dict_count > GPS_COLUMNS_DICT_MAX || !inside(dict, (size_t)col->dict_count * width, length))
+        return -1;
+      for (i = 0; i < rows; ++i)
+        if (col->data[i] >= col->dict_count)
+          return -1;
+      break;
+    default:
+      return -1;
+    }
+  }
+  *offset += length;
+  return 1;
+}
+
+void gps_columns_decode(const gps_columns_batch *batch, int column, int64_t *out)
+{
+  const gps_columns_column *col = &batch->columns[column];
+  byte width = width_of(column);
+  bool is_signed = (column_info[column].type & SIGNED) != 0;
+  size_t i;
+
+  switch (col->encoding)
+  {
+  case GPS_ENC_PLAIN:
+    for (i = 0; i < batch->rows; ++i)
+      out[i] = get_le(col->data + i * width, width, is_signed);
+    break;
+  case GPS_ENC_DELTA:
+    out[0] = col->base;
+    for (i = 1; i < batch->rows; ++i)
+      out[i] = (int64_t)((uint64_t)out[i - 1] +
+        (uint64_t)(col->width ? get_le(col->data + (i - 1) * col->width, col->width, true) : 0));
+    break;
+  case GPS_ENC_DICT:
+    for (i = 0; i < batch->rows; ++i)
+      out[i] = get_le(col->dict + col->data[i] * width, width, is_signed);
+    break;
+  }
+}
+
+bool gps_columns_is_valid(const gps_columns_batch *batch, int column, size_t row)
+{
+  const gps_columns_column *col = &batch->columns[column];
+  return col->validity == NULL || is_set(col->validity, row);
+}
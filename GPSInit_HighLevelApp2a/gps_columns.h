@@ -0,0 +1,173 @@
+/*
+gps_columns - columnar export of parsed fixes for offline analytics.
+
+Fixes are gathered into fixed-size record batches, one array per field,
+and each full batch is written out as a self-describing block in the
+spirit of the Arrow IPC file format: every buffer starts on an 8-byte
+boundary, nulls are an LSB-first validity bitmap, and a column is stored
+either plain (little-endian values that can be used in place from an
+mmap), as a base plus narrow deltas (time, position) or as a small
+dictionary plus 8-bit indexes (satellites, quality, HDOP). The encoding
+is picked per column and batch, whichever is smallest.
+
+Each batch starts with a zone map (time range, lat/lon bounding box and a
+Bloom filter of the geohash cells it visits) so that queries can skip it
+without touching its columns; see gps_query.h.
+
+File layout, all integers little-endian:
+  header   "GPSCOLS1", u16 version, u16 column count, u32 batch rows
+  schema   per column: u8 type (byte width, 0x80 if signed), u8 0, char name[14]
+  batch*   "BTCH", u32 rows, u32 length of the batch including this header,
+           u32 0, then the zone map (GPS_COLUMNS_ZONE_SIZE):
+             i64 min time, i64 max time, i32 min lat, i32 max lat,
+             i32 min lon, i32 max lon (min > max when no row has one),
+             u8 geohash characters, u8 Bloom hashes, u16 Bloom bits, u32 0,
+             Bloom bits LSB first
+           then one descriptor per column (GPS_COLUMNS_DESC_SIZE):
+             u8 encoding, u8 stored width, u16 dictionary entries,
+             u32 null count, i64 base, u32 validity offset (0 if no nulls),
+             u32 dictionary offset, u32 data offset, u32 data length
+           (offsets relative to the batch) followed by the buffers
+  end      a batch header with 0 rows
+*/
+
+#ifndef gps_columns_h
+#define gps_columns_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tinygps.h"
+
+#ifndef GPS_COLUMNS_BATCH
+#define GPS_COLUMNS_BATCH 1024       // rows per batch, a multiple of 8
+#endif
+
+#define GPS_COLUMNS_VERSION 2
+#define GPS_COLUMNS_HEADER_SIZE 16
+#define GPS_COLUMNS_SCHEMA_SIZE 16   // per column
+#define GPS_COLUMNS_BATCH_HEADER_SIZE 16
+#define GPS_COLUMNS_DESC_SIZE 32     // per column
+#define GPS_COLUMNS_DICT_MAX 256
+
+// zone map Bloom filter: geohash cells of this many characters (6 is about
+// 1.2 x 0.6 km), GPS_COLUMNS_BLOOM_BITS bits, GPS_COLUMNS_BLOOM_HASHES probes
+#ifndef GPS_COLUMNS_GEOHASH_CHARS
+#define GPS_COLUMNS_GEOHASH_CHARS 6
+#endif
+#define GPS_COLUMNS_BLOOM_BITS 512
+#define GPS_COLUMNS_BLOOM_HASHES 3
+#define GPS_COLUMNS_ZONE_SIZE (40 + GPS_COLUMNS_BLOOM_BITS / 8)
+
+  // column order in the file
+  enum {
+    GPS_COL_TIME,                    // int64 ms since 1970-01-01 UTC, from date and time
+    GPS_COL_LATITUDE,                // int32 10^-7 degree
+    GPS_COL_LONGITUDE,
+    GPS_COL_SPEED,                   // uint32 100ths of a knot
+    GPS_COL_COURSE,                  // uint32 100ths of a degree
+    GPS_COL_ALTITUDE,                // int32 centimeters
+    GPS_COL_HDOP,                    // uint16 100ths
+    GPS_COL_SATELLITES,              // uint8
+    GPS_COL_QUALITY,                 // uint8 GGA fix quality
+    GPS_COL_COUNT
+  };
+
+  enum {
+    GPS_ENC_PLAIN,                   // values at their full width
+    GPS_ENC_DELTA,                   // base, then rows - 1 signed differences (width 0: constant)
+    GPS_ENC_DICT                     // dictionary values at full width, then u8 indexes
+  };
+
+  // receives output; returns 0 on success
+  typedef int (*gps_columns_sink)(void *ctx, const void *data, size_t len);
+
+  typedef struct gps_columns_writer {
+    int64_t _time[GPS_COLUMNS_BATCH];
+    int32_t _latitude[GPS_COLUMNS_BATCH];
+    int32_t _longitude[GPS_COLUMNS_BATCH];
+    uint32_t _speed[GPS_COLUMNS_BATCH];
+    uint32_t _course[GPS_COLUMNS_BATCH];
+    int32_t _altitude[GPS_COLUMNS_BATCH];
+    uint16_t _hdop[GPS_COLUMNS_BATCH];
+    uint8_t _satellites[GPS_COLUMNS_BATCH];
+    uint8_t _quality[GPS_COLUMNS_BATCH];
+    byte _valid[GPS_COL_COUNT][GPS_COLUMNS_BATCH / 8];
+    size_t _rows;                    // in the current batch
+
+    // dictionary of the column being encoded, with an open-addressed index
+    int64_t _dict[GPS_COLUMNS_DICT_MAX];
+    short _dict_slots[2 * GPS_COLUMNS_DICT_MAX];
+
+    byte _out[1024];                 // staged output
+    size_t _out_len;
+    unsigned long _offset;           // bytes written to the sink so far
+    bool _started;
+
+    gps_fix _epoch;                  // gps_columns_add_nmea(): fix of the epoch being assembled
+    bool _epoch_open;
+    unsigned long _batches;
+  } gps_columns_writer;
+
+  void gps_columns_init(gps_columns_writer *w);
+
+  // Append one row; a full batch is encoded and written before returning.
+  // GPS_INVALID_* fields become nulls. Returns 0, or -1 if the sink failed
+  int gps_columns_add(gps_columns_writer *w, const gps_fix *fix, gps_columns_sink sink, void *ctx);
+
+  // Parse NMEA text with gps and append one row per epoch (all sentences
+  // carrying the same time), instead of one per sentence
+  int gps_columns_add_nmea(gps_columns_writer *w, gps_parser *gps, const char *buf, size_t len,
+    gps_columns_sink sink, void *ctx);
+
+  // write the partial batch and the end marker; call once
+  int gps_columns_finish(gps_columns_writer *w, gps_columns_sink sink, void *ctx);
+
+  // reading, typically from an mmap of the whole file
+
+  typedef struct gps_columns_zone {
+    size_t rows;
+    int64_t min_time, max_time;      // min > max when no row has a time
+    long min_latitude, max_latitude; // min > max when no row has a position
+    long min_longitude, max_longitude;
+    byte geohash_chars;
+    byte bloom[GPS_COLUMNS_BLOOM_BITS / 8];
+  } gps_columns_zone;
+
+  typedef struct gps_columns_column {
+    byte encoding;
+    byte width;                      // bytes per stored value or difference
+    unsigned short dict_count;
+    unsigned long null_count;
+    int64_t base;
+    const byte *validity;            // NULL when there are no nulls
+    const byte *dict;
+    const byte *data;
+    size_t data_len;
+  } gps_columns_column;
+
+  typedef struct gps_columns_batch {
+    size_t rows;
+    gps_columns_zone zone;
+    gps_columns_column columns[GPS_COL_COUNT];
+  } gps_columns_batch;
+
+  // check the file header; *offset is set to the first batch. Returns 0 or -1
+  int gps_columns_open(const void *file, size_t len, size_t *offset);
+
+  // view of the batch at *offset, then *offset moves past it.
+  // Returns 1, 0 at the end marker, or -1 if the file is corrupt
+  int gps_columns_next(const void *file, size_t len, size_t *offset, gps_columns_batch *batch);
+
+  // the same for just the zone map, without reading or checking the columns
+  int gps_columns_next_zone(const void *file, size_t len, size_t *offset, gps_columns_zone *zone);
+
+  // whether a batch may contain a position in this geohash cell (of
+  // zone->geohash_chars characters); false means it certainly does not
+  bool gps_columns_may_visit(const gps_columns_zone *zone, uint64_t cell);
+
+  // expand a column into rows values (null rows hold an unspecified value)
+  void gps_columns_decode(const gps_columns_batch *batch, int column, int64_t *out);
+
+  bool gps_columns_is_valid(const gps_columns_batch *batch, int column, size_t row);
+
+#endif
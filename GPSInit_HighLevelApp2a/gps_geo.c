@@ -0,0 +1,425 @@
+/*
+gps_geo - WGS-84 geodetic / ECEF / ENU / UTM transforms. See gps_geo.h.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "gps_geo.h"
+
+#define WGS84_B (GPS_WGS84_A * (1 - GPS_WGS84_F))
+#define WGS84_E2 (GPS_WGS84_F * (2 - GPS_WGS84_F))           // first eccentricity squared
+#define WGS84_EP2 (WGS84_E2 / (1 - WGS84_E2))                 // second eccentricity squared
+#define WGS84_E 0.0818191908426215                            // sqrt(WGS84_E2)
+
+// tinygps.h's PI is only good to 1e-9, a centimeter at the scale of the earth
+#define RAD_PER_DEG (3.14159265358979323846 / 180)
+
+// the fixed-point kernels work in 10^-7 degree whatever the gps_fix unit
+#define E7_PER_FIX_UNIT (10000000L / GPS_ANGLE_SCALE)
+#define E7_RAD (RAD_PER_DEG * 1e-7)
+#define Q32 4294967296.0
+#define Q64 (Q32 * Q32)
+
+// ---- geodetic <-> ECEF ----
+
+static inline void ecef_from_geodetic(double lat, double lon, double height, double ecef[3])
+{
+  double sin_lat = sin(lat * RAD_PER_DEG), cos_lat = cos(lat * RAD_PER_DEG);
+  double sin_lon = sin(lon * RAD_PER_DEG), cos_lon = cos(lon * RAD_PER_DEG);
+  double n = GPS_WGS84_A / sqrt(1 - WGS84_E2 * sin_lat * sin_lat);   // prime vertical radius
+
+  ecef[0] = (n + height) * cos_lat * cos_lon;
+  ecef[1] = (n + height) * cos_lat * sin_lon;
+  ecef[2] = (n * (1 - WGS84_E2) + height) * sin_lat;
+}
+
+void gps_ecef_from_geodetic(double lat, double lon, double height, double ecef[3])
+{
+  ecef_from_geodetic(lat, lon, height, ecef);
+}
+
+void gps_geodetic_from_ecef(const double ecef[3], double *lat, double *lon, double *height)
+{
+  const double a2 = GPS_WGS84_A * GPS_WGS84_A, b2 = WGS84_B * WGS84_B;
+  double x = ecef[0], y = ecef[1], z = ecef[2];
+  double p2 = x * x + y * y, p = sqrt(p2);
+  double f = 54 * b2 * z * z;
+  double g = p2 + (1 - WGS84_E2) * z * z - WGS84_E2 * (a2 - b2);
+  double c = WGS84_E2 * WGS84_E2 * f * p2 / (g * g * g);
+  double s = cbrt(1 + c + sqrt(c * c + 2 * c));
+  double k = s + 1 + 1 / s;
+  double pp = f / (3 * k * k * g * g);
+  double q = sqrt(1 + 2 * WGS84_E2 * WGS84_E2 * pp);
+  double r0 = -(pp * WGS84_E2 * p) / (1 + q) +
+    sqrt(a2 / 2 * (1 + 1 / q) - pp * (1 - WGS84_E2) * z * z / (q * (1 + q)) - pp * p2 / 2);
+  double t = p - WGS84_E2 * r0;
+  double u = sqrt(t * t + z * z);
+  double v = sqrt(t * t + (1 - WGS84_E2) * z * z);
+  double z0 = b2 * z / (GPS_WGS84_A * v);
+
+  *height = u * (1 - b2 / (GPS_WGS84_A * v));
+  *lat = atan2(z + WGS84_EP2 * z0, p) / RAD_PER_DEG;
+  *lon = atan2(y, x) / RAD_PER_DEG;
+}
+
+// ---- local tangent plane ----
+
+void gps_enu_init(gps_enu_ref *ref, double lat, double lon, double height)
+{
+  double sin_lat = sin(lat * RAD_PER_DEG), cos_lat = cos(lat * RAD_PER_DEG);
+  double sin_lon = sin(lon * RAD_PER_DEG), cos_lon = cos(lon * RAD_PER_DEG);
+  double w = 1 - WGS84_E2 * sin_lat * sin_lat;
+  double n = GPS_WGS84_A / sqrt(w);                 // prime vertical radius of curvature
+  double m = n * (1 - WGS84_E2) / w;                // meridian radius of curvature
+
+  ref->latitude = lat;
+  ref->longitude = lon;
+  ref->height = height;
+  ecef_from_geodetic(lat, lon, height, ref->origin);
+
+  ref->rot[0][0] = -sin_lon;
+  ref->rot[0][1] = cos_lon;
+  ref->rot[0][2] = 0;
+  ref->rot[1][0] = -sin_lat * cos_lon;
+  ref->rot[1][1] = -sin_lat * sin_lon;
+  ref->rot[1][2] = cos_lat;
+  ref->rot[2][0] = cos_lat * cos_lon;
+  ref->rot[2][1] = cos_lat * sin_lon;
+  ref->rot[2][2] = sin_lat;
+
+  // Taylor expansion of ENU about the reference, in millimeters per 10^-7 degree:
+  // east = (N cos lat) * dlon, where d(N cos lat)/dlat = -M sin lat; north is the
+  // meridian arc, whose radius grows by dM/dlat = 3 M e^2 sin cos / w, plus the
+  // bulge of the parallel towards the pole, N sin cos dlon^2 / 2
+  double e_b = (n + height) * cos_lat * E7_RAD * 1000;
+  double e_ab = m * sin_lat * E7_RAD * E7_RAD * 1000;
+  double n_a = (m + height) * E7_RAD * 1000;
+  double n_aa = 1.5 * m * WGS84_E2 * sin_lat * cos_lat / w * E7_RAD * E7_RAD * 1000;
+  double n_bb = 0.5 * n * sin_lat * cos_lat * E7_RAD * E7_RAD * 1000;
+
+  ref->lat0 = lrint(lat * 1e7);
+  ref->lon0 = lrint(lon * 1e7);
+  ref->e_b_q = llrint(e_b * Q32);
+  ref->e_ab_q = llrint(e_ab * Q64);
+  ref->n_a_q = llrint(n_a * Q32);
+  ref->n_aa_q = llrint(n_aa * Q64);
+  ref->n_bb_q = llrint(n_bb * Q64);
+  ref->inv_e_b_q = e_b > 0 ? llrint(Q32 / e_b) : 0;
+  ref->inv_n_a_q = llrint(Q32 / n_a);
+  ref->e_ab_over_e_b_q = e_b > 0 ? llrint(e_ab / e_b * Q64) : 0;
+}
+
+static inline void enu_from_ecef(const gps_enu_ref *ref, const double ecef[3],
+  double *east, double *north, double *up)
+{
+  double dx = ecef[0] - ref->origin[0];
+  double dy = ecef[1] - ref->origin[1];
+  double dz = ecef[2] - ref->origin[2];
+
+  *east = ref->rot[0][0] * dx + ref->rot[0][1] * dy;
+  *north = ref->rot[1][0] * dx + ref->rot[1][1] * dy + ref->rot[1][2] * dz;
+  *up = ref->rot[2][0] * dx + ref->rot[2][1] * dy + ref->rot[2][2] * dz;
+}
+
+void gps_enu_from_geodetic(const gps_enu_ref *ref, double lat, double lon, double height,
+  double enu[3])
+{
+  double ecef[3];
+
+  ecef_from_geodetic(lat, lon, height, ecef);
+  enu_from_ecef(ref, ecef, &enu[0], &enu[1], &enu[2]);
+}
+
+void gps_geodetic_from_enu(const gps_enu_ref *ref, const double enu[3],
+  double *lat, double *lon, double *height)
+{
+  double ecef[3];
+  int i;
+
+  for (i = 0; i < 3; ++i)
+    ecef[i] = ref->origin[i] + ref->rot[0][i] * enu[0] + ref->rot[1][i] * enu[1] + ref->rot[2][i] * enu[2];
+  gps_geodetic_from_ecef(ecef, lat, lon, height);
+}
+
+void gps_enu_from_geodetic_batch(const gps_enu_ref *ref, const double *lat, const double *lon,
+  const double *height, size_t count, double *east, double *north, double *up)
+{
+  size_t i;
+
+  for (i = 0; i < count; ++i)
+  {
+    double ecef[3];
+    ecef_from_geodetic(lat[i], lon[i], height[i], ecef);
+    enu_from_ecef(ref, ecef, &east[i], &north[i], &up[i]);
+  }
+}
+
+static inline int64_t clamp_offset(int64_t offset)
+{
+  offset = offset > GPS_ENU_FIXED_RANGE ? GPS_ENU_FIXED_RANGE : offset;
+  return offset < -GPS_ENU_FIXED_RANGE ? -GPS_ENU_FIXED_RANGE : offset;
+}
+
+// Every product below stays inside int64: offsets are at most 2^24, first-order
+// coefficients below 2^36 and second-order ones below 2^39
+static inline void enu_from_fixed(const gps_enu_ref *ref, long lat, long lon,
+  long *east_mm, long *north_mm)
+{
+  int64_t a = clamp_offset((int64_t)lat * E7_PER_FIX_UNIT - ref->lat0);
+  int64_t b = clamp_offset((int64_t)lon * E7_PER_FIX_UNIT - ref->lon0);
+
+  *east_mm = (long)((b * (ref->e_b_q - ((ref->e_ab_q * a) >> 32))) >> 32);
+  *north_mm = (long)((a * (ref->n_a_q + ((ref->n_aa_q * a) >> 32)) +
+                      b * ((ref->n_bb_q * b) >> 32)) >> 32);
+}
+
+void gps_enu_from_fixed(const gps_enu_ref *ref, long lat, long lon, long *east_mm, long *north_mm)
+{
+  enu_from_fixed(ref, lat, lon, east_mm, north_mm);
+}
+
+void gps_enu_from_fixed_batch(const gps_enu_ref *ref, const long *lat, const long *lon,
+  size_t count, long *east_mm, long *north_mm)
+{
+  size_t i;
+
+  for (i = 0; i < count; ++i)
+    enu_from_fixed(ref, lat[i], lon[i], &east_mm[i], &north_mm[i]);
+}
+
+// 10^-7 degree to gps_fix units, rounded to nearest
+static inline long fix_from_e7(int64_t e7)
+{
+  int64_t half = E7_PER_FIX_UNIT / 2;
+  return (long)((e7 + (e7 < 0 ? -half : half)) / E7_PER_FIX_UNIT);
+}
+
+void gps_fixed_from_enu(const gps_enu_ref *ref, long east_mm, long north_mm, long *lat, long *lon)
+{
+  // first-order offsets, then the second-order terms of the forward transform
+  // removed using them
+  int64_t b0 = ((int64_t)east_mm * ref->inv_e_b_q) >> 32;
+  int64_t a0 = ((int64_t)north_mm * ref->inv_n_a_q) >> 32;
+  int64_t bulge = (a0 * ((ref->n_aa_q * a0) >> 32) + b0 * ((ref->n_bb_q * b0) >> 32)) >> 32;
+  int64_t a = clamp_offset((((int64_t)north_mm - bulge) * ref->inv_n_a_q) >> 32);
+  int64_t b = clamp_offset(b0 + ((b0 * ((ref->e_ab_over_e_b_q * a) >> 32)) >> 32));
+
+  *lat = fix_from_e7(ref->lat0 + a);
+  *lon = fix_from_e7(ref->lon0 + b);
+}
+
+// ---- UTM ----
+
+#define UTM_K0 0.9996
+#define UTM_FALSE_EASTING 500000.0
+#define UTM_FALSE_NORTHING_SOUTH 10000000.0
+
+// third flattening and the Krueger series coefficients derived from it
+#define UTM_N (GPS_WGS84_F / (2 - GPS_WGS84_F))
+#define UTM_N2 (UTM_N * UTM_N)
+#define UTM_N3 (UTM_N2 * UTM_N)
+#define UTM_N4 (UTM_N3 * UTM_N)
+
+// rectifying radius times k0
+static const double utm_k0_a = UTM_K0 * GPS_WGS84_A / (1 + UTM_N) * (1 + UTM_N2 / 4 + UTM_N4 / 64);
+
+static const double utm_alpha[4] = {
+  UTM_N / 2 - 2 * UTM_N2 / 3 + 5 * UTM_N3 / 16 + 41 * UTM_N4 / 180,
+  13 * UTM_N2 / 48 - 3 * UTM_N3 / 5 + 557 * UTM_N4 / 1440,
+  61 * UTM_N3 / 240 - 103 * UTM_N4 / 140,
+  49561 * UTM_N4 / 161280
+};
+
+static const double utm_beta[4] = {
+  UTM_N / 2 - 2 * UTM_N2 / 3 + 37 * UTM_N3 / 96 - UTM_N4 / 360,
+  UTM_N2 / 48 + UTM_N3 / 15 - 437 * UTM_N4 / 1440,
+  17 * UTM_N3 / 480 - 37 * UTM_N4 / 840,
+  4397 * UTM_N4 / 161280
+};
+
+static const double utm_delta[4] = {
+  2 * UTM_N - 2 * UTM_N2 / 3 - 2 * UTM_N3 + 116 * UTM_N4 / 45,
+  7 * UTM_N2 / 3 - 8 * UTM_N3 / 5 - 227 * UTM_N4 / 45,
+  56 * UTM_N3 / 15 - 136 * UTM_N4 / 35,
+  4279 * UTM_N4 / 630
+};
+
+static double utm_central_meridian(int zone)
+{
+  return zone * 6 - 183.0;
+}
+
+int gps_utm_zone(double lat, double lon)
+{
+  int zone;
+
+  if (lon >= 180)
+    lon -= 360;
+  zone = (int)floor((lon + 180) / 6) + 1;
+  if (zone > 60)
+    zone = 60;
+
+  if (lat >= 56 && lat < 64 && lon >= 3 && lon < 12)
+    zone = 32;                        // south-west Norway
+  else if (lat >= 72 && lat < 84 && lon >= 0 && lon < 42)
+    zone = lon < 9 ? 31 : lon < 21 ? 33 : lon < 33 ? 35 : 37;   // Svalbard
+  return zone;
+}
+
+static inline void utm_from_geodetic(double lat, double lon, double central_meridian,
+  double *easting, double *northing)
+{
+  double dlon = lon - central_meridian;
+  double phi, lambda, sin_phi, t, xi, eta, x, y;
+  int j;
+
+  dlon -= 360 * floor((dlon + 180) / 360);
+  phi = lat * RAD_PER_DEG;
+  lambda = dlon * RAD_PER_DEG;
+  sin_phi = sin(phi);
+
+  // conformal latitude, then Gauss-Schreiber coordinates
+  t = sinh(atanh(sin_phi) - WGS84_E * atanh(WGS84_E * sin_phi));
+  xi = atan2(t, cos(lambda));
+  eta = atanh(sin(lambda) / sqrt(1 + t * t));
+
+  x = eta;
+  y = xi;
+  for (j = 0; j < 4; ++j)
+  {
+    double k = 2 * (j + 1);
+    x += utm_alpha[j] * cos(k * xi) * sinh(k * eta);
+    y += utm_alpha[j] * sin(k * xi) * cosh(k * eta);
+  }
+
+  *easting = UTM_FALSE_EASTING + utm_k0_a * x;
+  *northing = utm_k0_a * y + (lat < 0 ? UTM_FALSE_NORTHING_SOUTH : 0);
+}
+
+void gps_utm_from_geodetic(double lat, double lon, int zone, double *easting, double *northing)
+{
+  utm_from_geodetic(lat, lon, utm_central_meridian(zone), easting, northing);
+}
+
+void gps_utm_from_geodetic_batch(const double *lat, const double *lon, size_t count, int zone,
+  double *easting, double *northing)
+{
+  double central_meridian = utm_central_meridian(zone);
+  size_t i;
+
+  for (i = 0; i < count; ++i)
+    utm_from_geodetic(lat[i], lon[i], central_meridian, &easting[i], &northing[i]);
+}
+
+void gps_geodetic_from_utm(double easting, double northing, int zone, bool south,
+  double *lat, double *lon)
+{
+  double xi = (northing - (south ? UTM_FALSE_NORTHING_SOUTH : 0)) / utm_k0_a;
+  double eta = (easting - UTM_FALSE_EASTING) / utm_k0_a;
+  double xi1 = xi, eta1 = eta, chi, phi;
+  int j;
+
+  for (j = 0; j < 4; ++j)
+  {
+    double k = 2 * (j + 1);
+    xi1 -= utm_beta[j] * sin(k * xi) * cosh(k * eta);
+    eta1 -= utm_beta[j] * cos(k * xi) * sinh(k * eta);
+  }
+
+  chi = asin(sin(xi1) / cosh(eta1));  // conformal latitude
+  phi = chi;
+  for (j = 0; j < 4; ++j)
+    phi += utm_delta[j] * sin(2 * (j + 1) * chi);
+
+  *lat = phi / RAD_PER_DEG;
+  *lon = utm_central_meridian(zone) + atan2(sinh(eta1), cos(xi1)) / RAD_PER_DEG;
+}
+
+// ---- geohash ----
+
+static const char geohash_base32[] = "0123456789bcdefghjkmnpqrstuvwxyz";
+
+#define GEOHASH_LAT_RANGE ((int64_t)180 * GPS_ANGLE_SCALE)
+#define GEOHASH_LON_RANGE ((int64_t)360 * GPS_ANGLE_SCALE)
+
+// index of value in [0, range) split into 2^bits steps
+static uint64_t geohash_index(int64_t value, int64_t range, int bits)
+{
+  uint64_t top = ((uint64_t)1 << bits) - 1;
+
+  if (value < 0)
+    return 0;
+  if (value >= range)
+    return top;
+  return (uint64_t)((value << bits) / range);
+}
+
+// first value in step index of [0, range)
+static int64_t geohash_step_start(uint64_t index, int64_t range, int bits)
+{
+  int64_t span = (int64_t)1 << bits;
+  return ((int64_t)index * range + span - 1) >> bits;
+}
+
+uint64_t gps_geohash(long lat, long lon, int chars)
+{
+  int bits = 5 * chars, lon_bits = (bits + 1) / 2, lat_bits = bits / 2, i;
+  uint64_t y = geohash_index(lat + GEOHASH_LAT_RANGE / 2, GEOHASH_LAT_RANGE, lat_bits);
+  uint64_t x = geohash_index(lon + GEOHASH_LON_RANGE / 2, GEOHASH_LON_RANGE, lon_bits);
+  uint64_t cell = 0;
+
+  // from the most significant end: longitude, latitude, longitude, ...
+  for (i = 0; i < bits; ++i)
+    if (i % 2 == 0)
+      cell = cell << 1 | (x >> --lon_bits & 1);
+    else
+      cell = cell << 1 | (y >> --lat_bits & 1);
+  return cell;
+}
+
+void gps_geohash_string(uint64_t cell, int chars, char *out)
+{
+  int i;
+
+  for (i = chars - 1; i >= 0; --i, cell >>= 5)
+    out[i] = geohash_base32[cell & 31];
+  out[chars] = '\0';
+}
+
+bool gps_geohash_parse(const char *hash, uint64_t *cell, int *chars)
+{
+  uint64_t value = 0;
+  int n;
+
+  for (n = 0; hash[n] != '\0'; ++n)
+  {
+    char c = hash[n] >= 'A' && hash[n] <= 'Z' ? hash[n] - 'A' + 'a' : hash[n];
+    const char *digit = strchr(geohash_base32, c);
+    if (n == GPS_GEOHASH_MAX_CHARS || digit == NULL)
+      return false;
+    value = value << 5 | (uint64_t)(digit - geohash_base32);
+  }
+  if (n == 0)
+    return false;
+  *cell = value;
+  *chars = n;
+  return true;
+}
+
+void gps_geohash_bounds(uint64_t cell, int chars, long *min_lat, long *max_lat,
+  long *min_lon, long *max_lon)
+{
+  int bits = 5 * chars, lon_bits = (bits + 1) / 2, lat_bits = bits / 2, i;
+  uint64_t x = 0, y = 0;
+
+  for (i = bits - 1; i >= 0; --i)
+    if ((bits - 1 - i) % 2 == 0)
+      x = x << 1 | (cell >> i & 1);
+    else
+      y = y << 1 | (cell >> i & 1);
+
+  *min_lat = (long)(geohash_step_start(y, GEOHASH_LAT_RANGE, lat_bits) - GEOHASH_LAT_RANGE / 2);
+  *max_lat = (long)(geohash_step_start(y + 1, GEOHASH_LAT_RANGE, lat_bits) - 1 - GEOHASH_LAT_RANGE / 2);
+  *min_lon = (long)(geohash_step_start(x, GEOHASH_LON_RANGE, lon_bits) - GEOHASH_LON_RANGE / 2);
+  *max_lon = (long)(geohash_step_start(x + 1, GEOHASH_LON_RANGE, lon_bits) - 1 - GEOHASH_LON_RANGE / 2);
+}
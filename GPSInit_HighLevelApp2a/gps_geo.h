@@ -0,0 +1,108 @@
+/*
+gps_geo - coordinate transforms on the WGS-84 ellipsoid: geodetic
+(latitude, longitude, height), ECEF (earth-centred, earth-fixed), local
+ENU (east/north/up relative to a reference point) and UTM.
+
+Geometry that works in local metres needs no trigonometry per point:
+convert once with these kernels, then distances, geofences and filters
+are plain arithmetic. Everything that depends only on the reference
+point (its ECEF position, the ECEF<->ENU rotation and the fixed-point
+scale factors) is computed once by gps_enu_init.
+
+Angles are in degrees and lengths in meters unless noted. The *_batch
+forms apply the single-point kernel to arrays and are written without
+data-dependent branches so the compiler can unroll and pipeline them.
+*/
+
+#ifndef gps_geo_h
+#define gps_geo_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tinygps.h"
+
+#define GPS_WGS84_A 6378137.0                      // semi-major axis, meters
+#define GPS_WGS84_F (1 / 298.257223563)            // flattening
+
+// largest latitude or longitude offset from the reference the fixed-point
+// ENU kernels accept, in 10^-7 degree (about 1.67 degrees, so 185 km north
+// and less east away from the equator); larger offsets are clamped
+#define GPS_ENU_FIXED_RANGE (1L << 24)
+
+  typedef struct gps_enu_ref {
+    double latitude, longitude, height;
+    double origin[3];                 // ECEF of the reference point
+    double rot[3][3];                 // ECEF -> ENU rotation; its transpose is the inverse
+    // Fixed-point tangent plane. With a and b the latitude and longitude
+    // offsets in 10^-7 degree, east and north in millimeters are
+    //   e = b * (e_b - e_ab * a)
+    //   n = a * (n_a + n_aa * a) + b * (n_bb * b)
+    // First-order terms are Q32, second-order terms Q64
+    long lat0, lon0;                  // reference in 10^-7 degree
+    int64_t e_b_q, e_ab_q;
+    int64_t n_a_q, n_aa_q, n_bb_q;
+    int64_t inv_e_b_q, inv_n_a_q;     // 10^-7 degree per millimeter, Q32
+    int64_t e_ab_over_e_b_q;          // Q64
+  } gps_enu_ref;
+
+  // ---- geodetic <-> ECEF ----
+  void gps_ecef_from_geodetic(double lat, double lon, double height, double ecef[3]);
+  // closed form (Heikkinen); exact to well under a millimeter at any height
+  void gps_geodetic_from_ecef(const double ecef[3], double *lat, double *lon, double *height);
+
+  // ---- local tangent plane ----
+  void gps_enu_init(gps_enu_ref *ref, double lat, double lon, double height);
+
+  // exact, through ECEF
+  void gps_enu_from_geodetic(const gps_enu_ref *ref, double lat, double lon, double height,
+    double enu[3]);
+  void gps_geodetic_from_enu(const gps_enu_ref *ref, const double enu[3],
+    double *lat, double *lon, double *height);
+
+  void gps_enu_from_geodetic_batch(const gps_enu_ref *ref, const double *lat, const double *lon,
+    const double *height, size_t count, double *east, double *north, double *up);
+
+  // Integer east/north in millimeters from positions in gps_fix units, on
+  // the reference's tangent plane (height ignored). Second-order accurate:
+  // at mid latitudes within about 1 cm of the exact ENU inside 10 km and
+  // 1.5 m inside 50 km. The error grows towards the poles (5.5 m at 50 km
+  // at 70 degrees); use gps_enu_from_geodetic there or over longer ranges.
+  // gps_fixed_from_enu undoes it to within 5 cm inside 10 km and 3 m
+  // inside 50 km. tests/gps_geo_check.c measures all of these
+  void gps_enu_from_fixed(const gps_enu_ref *ref, long lat, long lon, long *east_mm, long *north_mm);
+  void gps_fixed_from_enu(const gps_enu_ref *ref, long east_mm, long north_mm, long *lat, long *lon);
+
+  void gps_enu_from_fixed_batch(const gps_enu_ref *ref, const long *lat, const long *lon,
+    size_t count, long *east_mm, long *north_mm);
+
+  // ---- UTM ----
+  // zone of a position, including the Norway and Svalbard exceptions
+  int gps_utm_zone(double lat, double lon);
+
+  // Transverse Mercator (Krueger series to n^4, well under 1 mm within the
+  // zone) in the given zone; northing has the 10,000 km false northing
+  // applied when the latitude is south
+  void gps_utm_from_geodetic(double lat, double lon, int zone, double *easting, double *northing);
+  void gps_geodetic_from_utm(double easting, double northing, int zone, bool south,
+    double *lat, double *lon);
+
+  // all points in one zone, as tracks and geofences need
+  void gps_utm_from_geodetic_batch(const double *lat, const double *lon, size_t count, int zone,
+    double *easting, double *northing);
+
+  // ---- geohash ----
+  // A cell of chars base-32 characters (1..GPS_GEOHASH_MAX_CHARS) as its
+  // 5 * chars interleaved bits, longitude first as in the string form.
+  // Positions and bounds are in gps_fix units; integer arithmetic only
+#define GPS_GEOHASH_MAX_CHARS 12
+
+  uint64_t gps_geohash(long lat, long lon, int chars);
+  // out receives chars characters and a NUL
+  void gps_geohash_string(uint64_t cell, int chars, char *out);
+  // false if hash is empty, too long or not geohash base 32
+  bool gps_geohash_parse(const char *hash, uint64_t *cell, int *chars);
+  // inclusive bounds of a cell
+  void gps_geohash_bounds(uint64_t cell, int chars, long *min_lat, long *max_lat,
+    long *min_lon, long *max_lon);
+
+#endif
@@ -0,0 +1,701 @@
+/*
+gps_mapmatch - HMM map matching over a preprocessed road graph.
+See gps_mapmatch.h.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "gps_mapmatch.h"
+
+static const byte file_magic[8] = { 'G', 'P', 'S', 'R', 'O', 'A', 'D', '1' };
+
+const gps_mapmatch_config gps_mapmatch_defaults = {
+  .sigma_m = 10,
+  .beta_m = 5,
+  .search_radius_m = 50,
+  .gap_ms = 30 * 1000
+};
+
+// routes longer than this many times the straight line (plus the slack
+// below) are not searched for
+#define DETOUR_FACTOR 2
+#define DETOUR_SLACK_M 100
+
+static uint32_t get_u32(const byte *p)
+{
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static long get_i32(const byte *p)
+{
+  return (long)(int32_t)get_u32(p);
+}
+
+// ---- graph ----
+
+int gps_roads_open(gps_roads *roads, const void *file, size_t len)
+{
+  const byte *p = file;
+  uint64_t nodes, segments, cells, entries, need;
+  unsigned long i, n, first, next;
+
+  if (len < GPS_ROADS_HEADER_SIZE || memcmp(p, file_magic, sizeof(file_magic)) != 0)
+    return -1;
+  nodes = get_u32(p + 8);
+  segments = get_u32(p + 12);
+  roads->_south = get_i32(p + 16);
+  roads->_west = get_i32(p + 20);
+  roads->_cell_size = get_u32(p + 24);
+  roads->_rows = (unsigned short)(p[28] | p[29] << 8);
+  roads->_columns = (unsigned short)(p[30] | p[31] << 8);
+  entries = get_u32(p + 32);
+  cells = (uint64_t)roads->_rows * roads->_columns;
+  if (roads->_cell_size == 0 || cells == 0)
+    return -1;
+
+  need = GPS_ROADS_HEADER_SIZE + segments * GPS_ROADS_SEGMENT_SIZE + 4 * (nodes + 1 + cells + 1 + entries);
+  if (need > len)
+    return -1;
+  roads->node_count = (unsigned long)nodes;
+  roads->segment_count = (unsigned long)segments;
+  roads->_segments = p + GPS_ROADS_HEADER_SIZE;
+  roads->_nodes = roads->_segments + segments * GPS_ROADS_SEGMENT_SIZE;
+  roads->_cells = roads->_nodes + 4 * (nodes + 1);
+  roads->_entries = roads->_cells + 4 * (cells + 1);
+
+  // node ranges cover the segments in order, and each segment starts at its node
+  first = 0;
+  for (n = 0; n < nodes; ++n)
+  {
+    next = get_u32(roads->_nodes + 4 * (n + 1));
+    if (get_u32(roads->_nodes + 4 * n) != first || next < first || next > segments)
+      return -1;
+    for (i = first; i < next; ++i)
+    {
+      const byte *s = roads->_segments + (size_t)i * GPS_ROADS_SEGMENT_SIZE;
+      if (get_u32(s + 16) != n || get_u32(s + 20) >= nodes)
+        return -1;
+    }
+    first = next;
+  }
+  if (first != segments)
+    return -1;
+
+  first = 0;
+  for (i = 0; i < cells; ++i)
+  {
+    next = get_u32(roads->_cells + 4 * (i + 1));
+    if (get_u32(roads->_cells + 4 * i) != first || next < first || next > entries)
+      return -1;
+    first = next;
+  }
+  if (first != entries)
+    return -1;
+  for (i = 0; i < entries; ++i)
+    if (get_u32(roads->_entries + 4 * i) >= segments)
+      return -1;
+  return 0;
+}
+
+void gps_roads_segment(const gps_roads *roads, unsigned long index, gps_road_segment *segment)
+{
+  const byte *s = roads->_segments + (size_t)index * GPS_ROADS_SEGMENT_SIZE;
+
+  segment->from_latitude = get_i32(s);
+  segment->from_longitude = get_i32(s + 4);
+  segment->to_latitude = get_i32(s + 8);
+  segment->to_longitude = get_i32(s + 12);
+  segment->from_node = get_u32(s + 16);
+  segment->to_node = get_u32(s + 20);
+  segment->way = get_u32(s + 24);
+  segment->length_m = (float)get_u32(s + 28) / 100;
+}
+
+static unsigned long from_node(const gps_roads *roads, unsigned long index)
+{
+  return get_u32(roads->_segments + (size_t)index * GPS_ROADS_SEGMENT_SIZE + 16);
+}
+
+static unsigned long to_node(const gps_roads *roads, unsigned long index)
+{
+  return get_u32(roads->_segments + (size_t)index * GPS_ROADS_SEGMENT_SIZE + 20);
+}
+
+static float length_of(const gps_roads *roads, unsigned long index)
+{
+  return (float)get_u32(roads->_segments + (size_t)index * GPS_ROADS_SEGMENT_SIZE + 28) / 100;
+}
+
+// ---- candidates ----
+
+void gps_mapmatch_init(gps_mapmatch *m, const gps_roads *roads, const gps_mapmatch_config *config)
+{
+  memset(m, 0, sizeof(*m));
+  m->_roads = roads;
+  m->_config = config ? *config : gps_mapmatch_defaults;
+  m->_cache_rows[0] = 1;             // empty range: nothing cached
+  m->_cache_rows[1] = 0;
+}
+
+static gps_mapmatch_column *column_at(gps_mapmatch *m, int k)
+{
+  return &m->_window[(m->_first + k) % GPS_MAPMATCH_WINDOW];
+}
+
+// local metres east and north of (lat, lon), m_per_lon the scale at lat
+static void local_xy(long lat, long lon, long to_lat, long to_lon, float m_per_lon, float *x, float *y)
+{
+  *x = (float)gps_delta_longitude(lon, to_lon) * m_per_lon;
+  *y = (float)(to_lat - lat) * GPS_METERS_PER_LAT_UNIT;
+}
+
+// project the fix in col onto segment and keep it if it is among the nearest
+static void consider(gps_mapmatch *m, gps_mapmatch_column *col, float m_per_lon, unsigned long index)
+{
+  gps_road_segment s;
+  gps_mapmatch_state *st;
+  float ax, ay, bx, by, dx, dy, t, px, py, d, len2;
+  int i;
+
+  for (i = 0; i < col->count; ++i)
+    if (col->states[i].segment == index)
+      return;
+  gps_roads_segment(m->_roads, index, &s);
+  local_xy(col->latitude, col->longitude, s.from_latitude, s.from_longitude, m_per_lon, &ax, &ay);
+  local_xy(col->latitude, col->longitude, s.to_latitude, s.to_longitude, m_per_lon, &bx, &by);
+  dx = bx - ax;
+  dy = by - ay;
+  len2 = dx * dx + dy * dy;
+  t = len2 > 0 ? -(ax * dx + ay * dy) / len2 : 0;
+  if (t < 0)
+    t = 0;
+  else if (t > 1)
+    t = 1;
+  px = ax + t * dx;
+  py = ay + t * dy;
+  d = sqrtf(px * px + py * py);
+  if (d > m->_config.search_radius_m)
+    return;
+
+  // insertion into the nearest GPS_MAPMATCH_CANDIDATES
+  i = col->count;
+  if (i == GPS_MAPMATCH_CANDIDATES)
+  {
+    if (d >= col->states[i - 1].distance)
+      return;
+    --i;
+  }
+  else
+  {
+    col->count++;
+  }
+  for (; i > 0 && col->states[i - 1].distance > d; --i)
+    col->states[i] = col->states[i - 1];
+  st = &col->states[i];
+  st->segment = index;
+  st->latitude = s.from_latitude + lroundf(t * (float)(s.to_latitude - s.from_latitude));
+  st->longitude = s.from_longitude + lroundf(t * (float)(s.to_longitude - s.from_longitude));
+  st->offset = t * s.length_m;
+  st->distance = d;
+}
+
+// index of the cell holding offset (from the grid's south-west corner), clamped
+// to [-1, count] so that it fits a long however far off the grid offset is
+static long cell_of(int64_t offset, unsigned long cell_size, long count)
+{
+  int64_t size = (int64_t)cell_size;
+  int64_t cell = offset >= 0 ? offset / size : -((-offset + size - 1) / size);
+  return cell < -1 ? -1 : cell > count ? count : (long)cell;
+}
+
+// add the segment to the sorted cache unless it is there
+static void cache_insert(gps_mapmatch *m, uint32_t index)
+{
+  unsigned lo = 0, hi = m->_cache_count;
+
+  if (m->_cache_count > GPS_MAPMATCH_CACHE)
+    return;
+  while (lo < hi)
+  {
+    unsigned mid = (lo + hi) / 2;
+    if (m->_cache[mid] < index)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo < m->_cache_count && m->_cache[lo] == index)
+    return;
+  if (m->_cache_count == GPS_MAPMATCH_CACHE)
+  {
+    m->_cache_count++;               // overflow: scan the cells instead
+    return;
+  }
+  memmove(&m->_cache[lo + 1], &m->_cache[lo], (m->_cache_count - lo) * sizeof(m->_cache[0]));
+  m->_cache[lo] = index;
+  m->_cache_count++;
+}
+
+// cache the segments of a cell range; false if they do not fit
+static bool gather(gps_mapmatch *m, const long *rows, const long *columns)
+{
+  const gps_roads *roads = m->_roads;
+  unsigned long e, end;
+  long r, c;
+
+  memcpy(m->_cache_rows, rows, sizeof(m->_cache_rows));
+  memcpy(m->_cache_columns, columns, sizeof(m->_cache_columns));
+  m->_cache_count = 0;
+  for (r = rows[0]; r <= rows[1] && m->_cache_count <= GPS_MAPMATCH_CACHE; ++r)
+    for (c = columns[0]; c <= columns[1]; ++c)
+    {
+      const byte *cell = roads->_cells + 4 * ((size_t)r * roads->_columns + c);
+      for (e = get_u32(cell), end = get_u32(cell + 4); e < end; ++e)
+        cache_insert(m, get_u32(roads->_entries + 4 * e));
+    }
+  return m->_cache_count <= GPS_MAPMATCH_CACHE;
+}
+
+static void find_candidates(gps_mapmatch *m, gps_mapmatch_column *col)
+{
+  const gps_roads *roads = m->_roads;
+  float m_per_lon = GPS_METERS_PER_LAT_UNIT * cosf((float)col->latitude / GPS_ANGLE_SCALE * (float)(PI / 180));
+  long reach_lat = (long)(m->_config.search_radius_m / GPS_METERS_PER_LAT_UNIT) + 1;
+  long reach_lon = m_per_lon > GPS_METERS_PER_LAT_UNIT / 1000 ?
+    (long)(m->_config.search_radius_m / m_per_lon) + 1 : 180L * GPS_ANGLE_SCALE;
+  long rows[2], columns[2], r, c;
+  unsigned long e, end;
+  unsigned i;
+
+  col->count = 0;
+  // 64-bit: a longitude plus the reach near a pole, less the grid's west edge,
+  // does not fit a 32-bit long
+  rows[0] = cell_of((int64_t)col->latitude - reach_lat - roads->_south, roads->_cell_size, roads->_rows);
+  rows[1] = cell_of((int64_t)col->latitude + reach_lat - roads->_south, roads->_cell_size, roads->_rows);
+  columns[0] = cell_of((int64_t)col->longitude - reach_lon - roads->_west, roads->_cell_size, roads->_columns);
+  columns[1] = cell_of((int64_t)col->longitude + reach_lon - roads->_west, roads->_cell_size, roads->_columns);
+  if (rows[1] < 0 || rows[0] >= roads->_rows || columns[1] < 0 || columns[0] >= roads->_columns)
+    return;
+  rows[0] = rows[0] < 0 ? 0 : rows[0];
+  rows[1] = rows[1] >= roads->_rows ? roads->_rows - 1 : rows[1];
+  columns[0] = columns[0] < 0 ? 0 : columns[0];
+  columns[1] = columns[1] >= roads->_columns ? roads->_columns - 1 : columns[1];
+
+  if (rows[0] >= m->_cache_rows[0] && rows[1] <= m->_cache_rows[1] &&
+      columns[0] >= m->_cache_columns[0] && columns[1] <= m->_cache_columns[1])
+  {
+    m->stats.cache_hits++;
+  }
+  else
+  {
+    // a ring of cells more than needed, so the next fixes hit
+    long padded_rows[2], padded_columns[2];
+    padded_rows[0] = rows[0] > 0 ? rows[0] - 1 : 0;
+    padded_rows[1] = rows[1] + 1 < roads->_rows ? rows[1] + 1 : rows[1];
+    padded_columns[0] = columns[0] > 0 ? columns[0] - 1 : 0;
+    padded_columns[1] = columns[1] + 1 < roads->_columns ? columns[1] + 1 : columns[1];
+    if (!gather(m, padded_rows, padded_columns))
+      gather(m, rows, columns);
+  }
+  if (m->_cache_count <= GPS_MAPMATCH_CACHE)
+  {
+    for (i = 0; i < m->_cache_count; ++i)
+      consider(m, col, m_per_lon, m->_cache[i]);
+    return;
+  }
+  for (r = rows[0]; r <= rows[1]; ++r)
+    for (c = columns[0]; c <= columns[1]; ++c)
+    {
+      const byte *cell = roads->_cells + 4 * ((size_t)r * roads->_columns + c);
+      for (e = get_u32(cell), end = get_u32(cell + 4); e < end; ++e)
+        consider(m, col, m_per_lon, get_u32(roads->_entries + 4 * e));
+    }
+}
+
+// ---- routes ----
+
+static int heap_push(gps_mapmatch *m, int *size, float dist, int slot)
+{
+  int i = *size, parent;
+
+  if (i == 2 * GPS_MAPMATCH_SEARCH)
+    return -1;
+  for (; i > 0; i = parent)
+  {
+    parent = (i - 1) / 2;
+    if (m->_heap_dist[parent] <= dist)
+      break;
+    m->_heap_dist[i] = m->_heap_dist[parent];
+    m->_heap_slot[i] = m->_heap_slot[parent];
+  }
+  m->_heap_dist[i] = dist;
+  m->_heap_slot[i] = (short)slot;
+  (*size)++;
+  return 0;
+}
+
+static int heap_pop(gps_mapmatch *m, int *size, float *dist)
+{
+  int slot = m->_heap_slot[0], n = --(*size), i = 0, child;
+  float last = m->_heap_dist[n];
+
+  *dist = m->_heap_dist[0];
+  for (;;)
+  {
+    child = 2 * i + 1;
+    if (child >= n)
+      break;
+    if (child + 1 < n && m->_heap_dist[child + 1] < m->_heap_dist[child])
+      child++;
+    if (last <= m->_heap_dist[child])
+      break;
+    m->_heap_dist[i] = m->_heap_dist[child];
+    m->_heap_slot[i] = m->_heap_slot[child];
+    i = child;
+  }
+  m->_heap_dist[i] = last;
+  m->_heap_slot[i] = m->_heap_slot[n];
+  return slot;
+}
+
+// slot of node in the search, added if new; -1 when the search is full
+static int node_slot(gps_mapmatch *m, int *nodes, uint32_t node)
+{
+  unsigned h = (unsigned)(node * 2654435761u) % (2 * GPS_MAPMATCH_SEARCH);
+
+  while (m->_slot[h] >= 0)
+  {
+    if (m->_node[m->_slot[h]] == node)
+      return m->_slot[h];
+    h = (h + 1) % (2 * GPS_MAPMATCH_SEARCH);
+  }
+  if (*nodes == GPS_MAPMATCH_SEARCH)
+    return -1;
+  m->_slot[h] = (short)*nodes;
+  m->_node[*nodes] = node;
+  m->_dist[*nodes] = INFINITY;
+  return (*nodes)++;
+}
+
+// Driving distance from source to the from node of each state in col,
+// stopping at limit metres; unreached nodes get INFINITY
+static void search(gps_mapmatch *m, uint32_t source, float limit, const gps_mapmatch_column *col, float *out)
+{
+  const gps_roads *roads = m->_roads;
+  int nodes = 0, heap = 0, remaining = col->count, slot, i;
+  unsigned long s, end;
+  float d;
+
+  m->stats.searches++;
+  for (i = 0; i < col->count; ++i)
+    out[i] = INFINITY;
+  memset(m->_slot, 0xFF, sizeof(m->_slot));
+  slot = node_slot(m, &nodes, source);
+  m->_dist[slot] = 0;
+  heap_push(m, &heap, 0, slot);
+
+  while (heap > 0 && remaining > 0)
+  {
+    slot = heap_pop(m, &heap, &d);
+    if (d > m->_dist[slot])
+      continue;                      // stale entry
+    for (i = 0; i < col->count; ++i)
+      if (isinf(out[i]) && from_node(roads, col->states[i].segment) == m->_node[slot])
+      {
+        out[i] = d;
+        remaining--;
+      }
+
+    s = get_u32(roads->_nodes + 4 * (size_t)m->_node[slot]);
+    end = get_u32(roads->_nodes + 4 * ((size_t)m->_node[slot] + 1));
+    for (; s < end; ++s)
+    {
+      float next = d + length_of(roads, s);
+      int to;
+      if (next > limit)
+        continue;
+      to = node_slot(m, &nodes, (uint32_t)to_node(roads, s));
+      if (to < 0 || next >= m->_dist[to])
+        continue;
+      m->_dist[to] = next;
+      if (heap_push(m, &heap, next, to) != 0)
+        return;
+    }
+  }
+}
+
+// ---- Viterbi ----
+
+static void deliver_unmatched(const gps_mapmatch_column *col, gps_mapmatch_sink sink, void *ctx)
+{
+  gps_mapmatch_result r;
+
+  r.time_ms = col->time_ms;
+  r.path_start = true;
+  r.segment = GPS_MAPMATCH_NONE;
+  r.way = GPS_MAPMATCH_NONE;
+  r.latitude = col->latitude;
+  r.longitude = col->longitude;
+  r.offset_m = 0;
+  r.distance_m = 0;
+  sink(ctx, &r);
+}
+
+static void deliver_state(gps_mapmatch *m, const gps_mapmatch_column *col, int state,
+  gps_mapmatch_sink sink, void *ctx)
+{
+  gps_mapmatch_result r;
+  gps_road_segment s;
+  const gps_mapmatch_state *st = &col->states[state];
+
+  gps_roads_segment(m->_roads, st->segment, &s);
+  r.time_ms = col->time_ms;
+  r.path_start = col->start;
+  r.segment = st->segment;
+  r.way = s.way;
+  r.latitude = st->latitude;
+  r.longitude = st->longitude;
+  r.offset_m = st->offset;
+  r.distance_m = st->distance;
+  sink(ctx, &r);
+}
+
+static int best_state(const gps_mapmatch_column *col)
+{
+  int i, best = -1;
+
+  for (i = 0; i < col->count; ++i)
+    if (!isinf(col->states[i].cost) && (best < 0 || col->states[i].cost < col->states[best].cost))
+      best = i;
+  return best;
+}
+
+// the state in the oldest column that state of the newest descends from
+static int ancestor(gps_mapmatch *m, int state)
+{
+  int k;
+
+  for (k = m->_count - 1; k > 0; --k)
+    state = column_at(m, k)->states[state].back;
+  return state;
+}
+
+// deliver the oldest column as state and drop it, pruning the paths
+// through its other states
+static void drop_oldest(gps_mapmatch *m, int state, gps_mapmatch_sink sink, void *ctx)
+{
+  int k, i;
+
+  deliver_state(m, column_at(m, 0), state, sink, ctx);
+  for (k = 1; k < m->_count; ++k)
+  {
+    gps_mapmatch_column *prev = column_at(m, k - 1), *col = column_at(m, k);
+    for (i = 0; i < col->count; ++i)
+      if (!isinf(col->states[i].cost) &&
+          (k == 1 ? col->states[i].back != state : isinf(prev->states[col->states[i].back].cost)))
+        col->states[i].cost = INFINITY;
+  }
+  m->_first = (byte)((m->_first + 1) % GPS_MAPMATCH_WINDOW);
+  m->_count--;
+}
+
+// deliver the leading columns every surviving path agrees on, then force
+// the oldest out if the window is full
+static void decide(gps_mapmatch *m, gps_mapmatch_sink sink, void *ctx)
+{
+  while (m->_count > 0)
+  {
+    gps_mapmatch_column *newest = column_at(m, m->_count - 1);
+    int i, agreed = -1;
+
+    for (i = 0; i < newest->count; ++i)
+    {
+      int a;
+      if (isinf(newest->states[i].cost))
+        continue;
+      a = ancestor(m, i);
+      if (agreed >= 0 && a != agreed)
+        break;
+      agreed = a;
+    }
+    if (i < newest->count || agreed < 0)
+      break;
+    drop_oldest(m, agreed, sink, ctx);
+  }
+  if (m->_count == GPS_MAPMATCH_WINDOW)
+  {
+    m->stats.forced++;
+    drop_oldest(m, ancestor(m, best_state(column_at(m, m->_count - 1))), sink, ctx);
+  }
+}
+
+// deliver the best path through the whole window
+static void flush(gps_mapmatch *m, gps_mapmatch_sink sink, void *ctx)
+{
+  signed char path[GPS_MAPMATCH_WINDOW];
+  int k, state;
+
+  if (m->_count == 0)
+    return;
+  state = best_state(column_at(m, m->_count - 1));
+  for (k = m->_count - 1; k >= 0; --k)
+  {
+    path[k] = (signed char)state;
+    state = column_at(m, k)->states[state].back;
+  }
+  for (k = 0; k < m->_count; ++k)
+    deliver_state(m, column_at(m, k), path[k], sink, ctx);
+  m->_first = (byte)((m->_first + m->_count) % GPS_MAPMATCH_WINDOW);
+  m->_count = 0;
+}
+
+// costs of reaching each state of col from the newest column; false if none can be
+static bool transition(gps_mapmatch *m, gps_mapmatch_column *col)
+{
+  const gps_roads *roads = m->_roads;
+  gps_mapmatch_column *prev = column_at(m, m->_count - 1);
+  float route[GPS_MAPMATCH_CANDIDATES], x, y, straight, limit, lowest = INFINITY;
+  float m_per_lon = GPS_METERS_PER_LAT_UNIT * cosf((float)col->latitude / GPS_ANGLE_SCALE * (float)(PI / 180));
+  float rest[GPS_MAPMATCH_CANDIDATES];
+  uint32_t node[GPS_MAPMATCH_CANDIDATES], searched = 0xFFFFFFFFu;
+  int i, j, k;
+
+  local_xy(prev->latitude, prev->longitude, col->latitude, col->longitude, m_per_lon, &x, &y);
+  straight = sqrtf(x * x + y * y);
+  limit = DETOUR_FACTOR * straight + 2 * m->_config.search_radius_m + DETOUR_SLACK_M;
+
+  for (j = 0; j < col->count; ++j)
+  {
+    col->states[j].cost = INFINITY;
+    col->states[j].back = -1;
+  }
+  for (i = 0; i < prev->count; ++i)
+  {
+    rest[i] = length_of(roads, prev->states[i].segment) - prev->states[i].offset;
+    node[i] = (uint32_t)to_node(roads, prev->states[i].segment);
+  }
+  // Previous states are nearest first, so twins sharing a to node often follow
+  // each other. Each state may route limit - rest metres on from its node, so a
+  // search shared by the twins goes as far as the one with the least rest needs,
+  // and each state then drops the routes beyond its own limit
+  for (i = 0; i < prev->count; ++i)
+  {
+    const gps_mapmatch_state *p = &prev->states[i];
+
+    if (isinf(p->cost))
+      continue;
+    if (node[i] != searched)
+    {
+      float least = rest[i];
+      for (k = i + 1; k < prev->count; ++k)
+        if (node[k] == node[i] && !isinf(prev->states[k].cost) && rest[k] < least)
+          least = rest[k];
+      search(m, node[i], limit - least, col, route);
+      searched = node[i];
+    }
+    for (j = 0; j < col->count; ++j)
+    {
+      gps_mapmatch_state *s = &col->states[j];
+      float r, cost;
+      if (s->segment == p->segment)
+        r = fabsf(s->offset - p->offset);
+      else if (route[j] > 0 && route[j] > limit - rest[i])
+        continue;                    // unreached, or only within a twin's limit
+      else
+        r = rest[i] + route[j] + s->offset;
+      cost = p->cost + fabsf(r - straight) / m->_config.beta_m;
+      if (cost < s->cost)
+      {
+        s->cost = cost;
+        s->back = (signed char)i;
+      }
+    }
+  }
+
+  for (j = 0; j < col->count; ++j)
+  {
+    gps_mapmatch_state *s = &col->states[j];
+    float e = s->distance / m->_config.sigma_m;
+    s->cost += e * e / 2;
+    if (s->cost < lowest)
+      lowest = s->cost;
+  }
+  if (isinf(lowest))
+    return false;
+  // keep costs near zero so they do not lose precision over long runs
+  for (j = 0; j < col->count; ++j)
+    col->states[j].cost -= lowest;
+  return true;
+}
+
+static void start_path(gps_mapmatch *m, gps_mapmatch_column *col)
+{
+  int j;
+
+  col->start = true;
+  for (j = 0; j < col->count; ++j)
+  {
+    float e = col->states[j].distance / m->_config.sigma_m;
+    col->states[j].cost = e * e / 2;
+    col->states[j].back = -1;
+  }
+}
+
+void gps_mapmatch_add(gps_mapmatch *m, int64_t time_ms, long latitude, long longitude,
+  gps_mapmatch_sink sink, void *ctx)
+{
+  gps_mapmatch_column *col;
+  bool gap;
+
+  if (m->_have_last && time_ms <= m->_last_time)
+    return;
+  gap = m->_have_last && (uint64_t)(time_ms - m->_last_time) > m->_config.gap_ms;
+  m->_have_last = true;
+  m->_last_time = time_ms;
+  m->stats.fixes++;
+
+  // the slot after the newest column, free since the window is never left
+  // full; a flush makes it the oldest
+  col = column_at(m, m->_count);
+  col->time_ms = time_ms;
+  col->latitude = latitude;
+  col->longitude = longitude;
+  col->start = false;
+  find_candidates(m, col);
+
+  if (col->count == 0)
+  {
+    m->stats.unmatched++;
+    if (m->_count > 0)
+      m->stats.breaks++;
+    flush(m, sink, ctx);
+    deliver_unmatched(col, sink, ctx);
+    return;
+  }
+  if (m->_count == 0)
+  {
+    start_path(m, col);
+  }
+  else if (gap || !transition(m, col))
+  {
+    m->stats.breaks++;
+    flush(m, sink, ctx);
+    start_path(m, col);
+  }
+  m->_count++;
+  decide(m, sink, ctx);
+}
+
+void gps_mapmatch_add_fix(gps_mapmatch *m, const gps_fix *fix, gps_mapmatch_sink sink, void *ctx)
+{
+  int64_t ms;
+
+  if (fix->latitude == GPS_INVALID_ANGLE || !gps_fix_time_ms(fix, &ms))
+    return;
+  gps_mapmatch_add(m, ms, fix->latitude, fix->longitude, sink, ctx);
+}
+
+void gps_mapmatch_finish(gps_mapmatch *m, gps_mapmatch_sink sink, void *ctx)
+{
+  flush(m, sink, ctx);
+  m->_have_last = false;
+}
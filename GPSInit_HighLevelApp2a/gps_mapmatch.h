@@ -0,0 +1,179 @@
+/*
+gps_mapmatch - snaps fixes to roads with a hidden Markov model over a
+preprocessed road graph, typically mmapped from storage.
+
+The candidates for a fix are the nearest directed segments within
+search_radius_m of it, found through the graph's grid index. Segments are
+gathered for the cells in reach plus a ring around them and cached, so
+until the device leaves that ring consecutive fixes only re-project onto
+the cached segments.
+Scores are costs (negative log probabilities, constants dropped):
+  emission    (d / sigma_m)^2 / 2, d the distance from the fix to the road
+  transition  |route - straight| / beta_m, route the driving distance
+              between two candidates and straight the distance between
+              their fixes (Newson and Krumm)
+Routes come from a Dijkstra search bounded to GPS_MAPMATCH_SEARCH nodes
+and to a detour limit, so a step costs at most one search per candidate.
+
+Viterbi runs online over a window of at most GPS_MAPMATCH_WINDOW fixes.
+A fix is reported once every surviving path agrees on it, and at the
+latest when it is GPS_MAPMATCH_WINDOW - 1 fixes old, when the best path
+decides it and paths that disagree are dropped. A fix with no road in
+reach, a time gap or a fix that no candidate can be reached from breaks
+the path: the window is flushed and a new path starts. Every fix passed
+in comes out exactly once, in order.
+
+Distances are the flat-earth metres of gps_fast_distance_between(),
+from integer 10^-7 degree offsets (gps_delta_longitude(), so across the
+antimeridian too) with one cosine per fix.
+
+Graph file layout, little-endian, every section a multiple of 4 bytes:
+  header    "GPSROAD1", u32 nodes, u32 segments, i32 grid south latitude,
+            i32 grid west longitude, u32 cell size, u16 grid rows,
+            u16 grid columns, u32 cell entries, u32 0
+            (GPS_ROADS_HEADER_SIZE; angles in 10^-7 degree)
+  segments  per segment (GPS_ROADS_SEGMENT_SIZE): i32 from latitude,
+            i32 from longitude, i32 to latitude, i32 to longitude,
+            u32 from node, u32 to node, u32 way id, u32 length in cm;
+            sorted by from node. A two-way road is two segments
+  nodes     nodes + 1 u32: index of each node's first segment, then the
+            segment count
+  cells     rows * columns + 1 u32: index of each cell's first entry,
+            row by row from the south-west corner, then the entry count
+  entries   u32 segment indexes; a segment is listed in every cell its
+            bounding box touches
+*/
+
+#ifndef gps_mapmatch_h
+#define gps_mapmatch_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tinygps.h"
+
+#define GPS_ROADS_HEADER_SIZE 40
+#define GPS_ROADS_SEGMENT_SIZE 32
+
+#ifndef GPS_MAPMATCH_CANDIDATES
+#define GPS_MAPMATCH_CANDIDATES 12   // per fix, nearest first
+#endif
+#define GPS_MAPMATCH_WINDOW 16       // lattice columns; the lag is at most one less
+#define GPS_MAPMATCH_CACHE 256       // segments gathered per cell range
+#define GPS_MAPMATCH_SEARCH 128      // nodes a route search may reach
+#define GPS_MAPMATCH_NONE 0xFFFFFFFFUL
+
+  // view of a graph file; the file must outlive it
+  typedef struct gps_roads {
+    unsigned long node_count;
+    unsigned long segment_count;
+    const byte *_segments;
+    const byte *_nodes;
+    const byte *_cells;
+    const byte *_entries;
+    long _south, _west;
+    unsigned long _cell_size;
+    unsigned short _rows, _columns;
+  } gps_roads;
+
+  typedef struct gps_road_segment {
+    long from_latitude, from_longitude;
+    long to_latitude, to_longitude;
+    unsigned long from_node, to_node;
+    unsigned long way;
+    float length_m;
+  } gps_road_segment;
+
+  // Check the whole file once (indexes in range, segments sorted) so that
+  // matching needs no further checks. Returns 0, or -1 if it is not a
+  // valid graph
+  int gps_roads_open(gps_roads *roads, const void *file, size_t len);
+
+  void gps_roads_segment(const gps_roads *roads, unsigned long index, gps_road_segment *segment);
+
+  typedef struct gps_mapmatch_config {
+    float sigma_m;                   // GPS noise
+    float beta_m;                    // typical route/straight-line difference per step
+    float search_radius_m;           // candidate search radius
+    unsigned long gap_ms;            // longer gaps between fixes break the path
+  } gps_mapmatch_config;
+
+  // 10 m, 5 m, 50 m, 30 s
+  extern const gps_mapmatch_config gps_mapmatch_defaults;
+
+  typedef struct gps_mapmatch_result {
+    int64_t time_ms;                 // as passed in
+    unsigned long segment;           // GPS_MAPMATCH_NONE if no road was in reach
+    unsigned long way;
+    long latitude, longitude;        // on the road; the fix itself when unmatched
+    float offset_m;                  // along the segment from its from node
+    float distance_m;                // from the fix to the road
+    bool path_start;                 // first fix of a path, after a break
+  } gps_mapmatch_result;
+
+  typedef void (*gps_mapmatch_sink)(void *ctx, const gps_mapmatch_result *result);
+
+  typedef struct gps_mapmatch_stats {
+    unsigned long fixes;
+    unsigned long unmatched;         // no road in reach
+    unsigned long breaks;            // paths broken by gaps or unreachable fixes
+    unsigned long forced;            // fixes decided by the window limit
+    unsigned long cache_hits;        // candidate lookups served from the cache
+    unsigned long searches;          // route searches run
+  } gps_mapmatch_stats;
+
+  // one candidate in the lattice
+  typedef struct gps_mapmatch_state {
+    unsigned long segment;
+    long latitude, longitude;        // projection onto the segment
+    float offset, distance;          // metres
+    float cost;                      // of the best path ending here; INFINITY once pruned
+    signed char back;                // state in the previous column
+  } gps_mapmatch_state;
+
+  typedef struct gps_mapmatch_column {
+    int64_t time_ms;
+    long latitude, longitude;        // the fix
+    bool start;
+    byte count;
+    gps_mapmatch_state states[GPS_MAPMATCH_CANDIDATES];
+  } gps_mapmatch_column;
+
+  typedef struct gps_mapmatch {
+    const gps_roads *_roads;
+    gps_mapmatch_config _config;
+    gps_mapmatch_stats stats;
+
+    gps_mapmatch_column _window[GPS_MAPMATCH_WINDOW];   // ring
+    byte _first, _count;
+    bool _have_last;
+    int64_t _last_time;
+
+    // segments of the cell range last gathered; _cache_count > GPS_MAPMATCH_CACHE
+    // when they did not fit
+    long _cache_rows[2], _cache_columns[2];
+    unsigned _cache_count;
+    uint32_t _cache[GPS_MAPMATCH_CACHE];
+
+    // route search: nodes reached, their distance, a hash of node to slot
+    // and a binary heap of (distance, slot)
+    uint32_t _node[GPS_MAPMATCH_SEARCH];
+    float _dist[GPS_MAPMATCH_SEARCH];
+    short _slot[2 * GPS_MAPMATCH_SEARCH];
+    float _heap_dist[2 * GPS_MAPMATCH_SEARCH];
+    short _heap_slot[2 * GPS_MAPMATCH_SEARCH];
+  } gps_mapmatch;
+
+  // roads must stay valid while matching; config may be NULL for
+  // gps_mapmatch_defaults
+  void gps_mapmatch_init(gps_mapmatch *m, const gps_roads *roads, const gps_mapmatch_config *config);
+
+  // Feed fixes in time order; repeats of the last time are ignored.
+  // Results for earlier fixes may be delivered to sink before returning
+  void gps_mapmatch_add(gps_mapmatch *m, int64_t time_ms, long latitude, long longitude,
+    gps_mapmatch_sink sink, void *ctx);
+  void gps_mapmatch_add_fix(gps_mapmatch *m, const gps_fix *fix, gps_mapmatch_sink sink, void *ctx);
+
+  // deliver the fixes still in the window
+  void gps_mapmatch_finish(gps_mapmatch *m, gps_mapmatch_sink sink, void *ctx);
+
+#endif
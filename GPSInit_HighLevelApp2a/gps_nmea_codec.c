@@ -0,0 +1,764 @@
+/*
+gps_nmea_codec - lossless, field-aware NMEA compression. See gps_nmea_codec.h.
+
+Stream layout: the 4-byte magic "NMZ1", then records.
+  record  = type index (< GPS_CODEC_TYPES) fields
+          | OP_NEW_TYPE len name fields      defines the next type index
+          | OP_RAW varint(len) bytes         literal input
+  fields  = field* (OP_END | OP_END_LF)
+  field   = OP_EMPTY | OP_SAME | OP_TEXT len bytes
+          | OP_NUM_FORMAT varint(format) zigzag(delta)
+          | OP_NUM zigzag(delta) | OP_NUM_TREND zigzag(delta - last delta)
+          | OP_SMALL_DELTA + delta
+A coded sentence is rebuilt as "$" name ("," field)* "*" checksum "\r\n",
+or with a bare "\n" after OP_END_LF.
+*/
+
+#include <string.h>
+#include "gps_nmea_codec.h"
+
+static const byte codec_magic[4] = { 'N', 'M', 'Z', '1' };
+
+enum {
+  OP_NEW_TYPE = 0xFE,
+  OP_RAW = 0xFF
+};
+
+enum {
+  OP_END,
+  OP_END_LF,                         // sentence ended in "\n" alone
+  OP_EMPTY,
+  OP_SAME,                           // same text as this column last time
+  OP_TEXT,
+  OP_NUM_FORMAT,                     // number written differently from last time
+  OP_NUM,                            // same format, large delta
+  OP_NUM_TREND,                      // same format, delta close to the last one
+  OP_SMALL_DELTA_FIRST,
+  OP_SMALL_DELTA_ZERO = 0x80         // same format, delta = op - OP_SMALL_DELTA_ZERO
+};
+
+#define SMALL_DELTA_MIN (OP_SMALL_DELTA_FIRST - OP_SMALL_DELTA_ZERO)
+#define SMALL_DELTA_MAX (0xFF - OP_SMALL_DELTA_ZERO)
+#define MAX_DIGITS 18                // fits int64 with room for deltas
+#define BODY_MAX (GPS_CODEC_LINE_MAX - 5)  // a collected line less "*HH\r\n"
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+// ---- numbers ----
+
+// format = 1 + (negative << 11 | has_point << 10 | integer digits << 5 | fraction digits)
+static bool parse_number(const char *s, size_t n, int64_t *value, unsigned short *format)
+{
+  bool negative = false, point = false;
+  unsigned int int_digits = 0, frac_digits = 0;
+  int64_t v = 0;
+  size_t i = 0;
+
+  if (n > 0 && s[0] == '-')
+  {
+    negative = true;
+    i = 1;
+  }
+  for (; i < n && gpsisdigit(s[i]); ++i, ++int_digits)
+    v = v * 10 + (s[i] - '0');
+  if (i < n && s[i] == '.')
+  {
+    point = true;
+    for (++i; i < n && gpsisdigit(s[i]); ++i, ++frac_digits)
+      v = v * 10 + (s[i] - '0');
+  }
+  if (i != n || int_digits == 0 || int_digits + frac_digits > MAX_DIGITS)
+    return false;
+
+  *value = negative ? -v : v;
+  *format = (unsigned short)(1 + ((unsigned)negative << 11 | (unsigned)point << 10 |
+    int_digits << 5 | frac_digits));
+  return true;
+}
+
+// inverse of parse_number; returns the length written to out
+static size_t render_number(int64_t value, unsigned short format, char *out)
+{
+  unsigned int code = format - 1u;
+  bool negative = code >> 11 & 1, point = code >> 10 & 1;
+  unsigned int int_digits = code >> 5 & 31, frac_digits = code & 31;
+  unsigned int digits = int_digits + frac_digits, i;
+  uint64_t v = (uint64_t)(negative ? -value : value);
+  size_t len = 0;
+  char tmp[MAX_DIGITS];
+
+  for (i = digits; i > 0; --i)
+  {
+    tmp[i - 1] = (char)('0' + v % 10);
+    v /= 10;
+  }
+  if (negative)
+    out[len++] = '-';
+  memcpy(out + len, tmp, int_digits);
+  len += int_digits;
+  if (point)
+  {
+    out[len++] = '.';
+    memcpy(out + len, tmp + int_digits, frac_digits);
+    len += frac_digits;
+  }
+  return len;
+}
+
+// characters render_number writes for this format
+static size_t number_length(unsigned short format)
+{
+  unsigned int code = format - 1u;
+  return (code >> 11 & 1) + (code >> 5 & 31) + ((code >> 10 & 1) ? 1 + (code & 31) : 0);
+}
+
+// whether render_number can write value in this format, for values from a corrupt stream
+static bool number_fits(int64_t value, unsigned short format)
+{
+  unsigned int code = format - 1u, digits = (code >> 5 & 31) + (code & 31), i;
+  uint64_t limit = 1;
+
+  if ((code >> 11 & 1) ? value > 0 || value == INT64_MIN : value < 0)
+    return false;
+  for (i = 0; i < digits; ++i)
+    limit *= 10;
+  return (uint64_t)(value < 0 ? -value : value) < limit;
+}
+
+static bool valid_format(uint64_t format)
+{
+  uint64_t code = format - 1;
+  return format != 0 && code < (1u << 12) && (code >> 5 & 31) != 0 &&
+    (code >> 5 & 31) + (code & 31) <= MAX_DIGITS && ((code >> 10 & 1) || (code & 31) == 0);
+}
+
+// ---- varints ----
+
+static byte *put_varint(byte *p, uint64_t v)
+{
+  while (v >= 0x80)
+  {
+    *p++ = (byte)(v | 0x80);
+    v >>= 7;
+  }
+  *p++ = (byte)v;
+  return p;
+}
+
+static size_t varint_length(uint64_t v)
+{
+  size_t len = 1;
+  while (v >= 0x80)
+  {
+    v >>= 7;
+    ++len;
+  }
+  return len;
+}
+
+// returns the bytes read, 0 if the input ends first, or -1 if the value is
+// too long or not in the shortest form put_varint writes. Accepting only the
+// shortest form keeps every valid record within GPS_CODEC_RECORD_MAX
+static long get_varint(const byte *p, const byte *end, uint64_t *v)
+{
+  uint64_t result = 0;
+  unsigned int shift;
+  const byte *start = p;
+
+  for (shift = 0; shift < 64; shift += 7)
+  {
+    byte b;
+    if (p == end)
+      return 0;
+    b = *p++;
+    if (shift == 63 && b > 1)
+      return -1;                     // more than 64 bits
+    result |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80))
+    {
+      if (b == 0 && shift != 0)
+        return -1;                   // redundant high byte
+      *v = result;
+      return (long)(p - start);
+    }
+  }
+  return -1;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// ---- model ----
+
+static int find_type(const gps_codec_model *model, const char *name, size_t len)
+{
+  int i;
+  for (i = 0; i < model->type_count; ++i)
+    if (model->types[i].name_len == len && memcmp(model->types[i].name, name, len) == 0)
+      return i;
+  return -1;
+}
+
+static void remember_text(gps_codec_column *col, const char *text, size_t len)
+{
+  if (len <= GPS_CODEC_FIELD_MAX)
+  {
+    memcpy(col->text, text, len);
+    col->text_len = (byte)len;
+  }
+  else
+  {
+    col->text_len = 0xFF;
+  }
+}
+
+// ---- encoder ----
+
+void gps_codec_encoder_init(gps_codec_encoder *enc)
+{
+  memset(enc, 0, sizeof(*enc));
+}
+
+static int flush_out(byte *out, size_t *out_len, gps_codec_sink sink, void *ctx)
+{
+  if (*out_len != 0 && sink(ctx, out, *out_len) != 0)
+    return -1;
+  *out_len = 0;
+  return 0;
+}
+
+// make room for one record
+static int reserve(gps_codec_encoder *enc, gps_codec_sink sink, void *ctx)
+{
+  if (enc->_out_len + GPS_CODEC_RECORD_MAX > sizeof(enc->_out))
+    return flush_out(enc->_out, &enc->_out_len, sink, ctx);
+  return 0;
+}
+
+static int emit_raw(gps_codec_encoder *enc, gps_codec_sink sink, void *ctx)
+{
+  byte *p;
+
+  if (enc->_raw_len == 0)
+    return 0;
+  if (reserve(enc, sink, ctx) != 0)
+    return -1;
+  p = enc->_out + enc->_out_len;
+  *p++ = OP_RAW;
+  p = put_varint(p, enc->_raw_len);
+  memcpy(p, enc->_raw, enc->_raw_len);
+  p += enc->_raw_len;
+  enc->_out_len = (size_t)(p - enc->_out);
+  enc->_literal_bytes += enc->_raw_len;
+  enc->_raw_len = 0;
+  return 0;
+}
+
+static int add_raw(gps_codec_encoder *enc, const void *data, size_t len, gps_codec_sink sink, void *ctx)
+{
+  const byte *p = data;
+
+  while (len > 0)
+  {
+    size_t take = sizeof(enc->_raw) - enc->_raw_len;
+    if (take > len)
+      take = len;
+    memcpy(enc->_raw + enc->_raw_len, p, take);
+    enc->_raw_len += take;
+    p += take;
+    len -= take;
+    if (enc->_raw_len == sizeof(enc->_raw) && emit_raw(enc, sink, ctx) != 0)
+      return -1;
+  }
+  return 0;
+}
+
+// the collected line with its '$', as literal bytes
+static int abandon_line(gps_codec_encoder *enc, gps_codec_sink sink, void *ctx)
+{
+  enc->_in_line = false;
+  if (add_raw(enc, "$", 1, sink, ctx) != 0)
+    return -1;
+  return add_raw(enc, enc->_line, enc->_line_len, sink, ctx);
+}
+
+static int hex_value(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;                         // lower case would not be reproduced
+}
+
+// Codes the collected line if it is a well-formed sentence the model can
+// hold; returns 1 if coded, 0 if it must go out as literal bytes
+static int encode_sentence(gps_codec_encoder *enc, gps_codec_sink sink, void *ctx)
+{
+  const char *line = enc->_line;
+  size_t len = enc->_line_len, body_len, i, start, field_count = 0;
+  bool crlf;
+  size_t field_start[GPS_CODEC_COLUMNS + 1], field_len[GPS_CODEC_COLUMNS + 1];
+  byte parity = 0;
+  int high, low, type;
+  gps_codec_model *model = &enc->_model;
+  byte *p;
+
+  // "*HH\r\n" (or "*HH\n") with the correct checksum
+  if (len < 5 || line[len - 1] != '\n')
+    return 0;
+  crlf = line[len - 2] == '\r';
+  body_len = len - (crlf ? 5 : 4);
+  if (body_len > BODY_MAX || line[body_len] != '*')
+    return 0;
+  high = hex_value(line[body_len + 1]);
+  low = hex_value(line[body_len + 2]);
+  if (high < 0 || low < 0)
+    return 0;
+
+  // split into terms; the body must hold nothing but ordinary characters and commas
+  for (i = 0, start = 0; i <= body_len; ++i)
+  {
+    byte cls = i < body_len ? gps_char_class[(byte)line[i]] : GPS_CC_COMMA;
+    if (cls == GPS_CC_ORDINARY)
+    {
+      parity ^= (byte)line[i];
+      continue;
+    }
+    if (cls != GPS_CC_COMMA || field_count > GPS_CODEC_COLUMNS)
+      return 0;
+    if (i < body_len)
+      parity ^= ',';
+    field_start[field_count] = start;
+    field_len[field_count++] = i - start;
+    start = i + 1;
+  }
+  if (parity != (high << 4 | low) || field_len[0] == 0 || field_len[0] > GPS_CODEC_NAME_MAX)
+    return 0;
+
+  type = find_type(model, line, field_len[0]);
+  if (type < 0 && model->type_count == GPS_CODEC_TYPES)
+    return 0;
+
+  if (emit_raw(enc, sink, ctx) != 0 || reserve(enc, sink, ctx) != 0)
+    return -1;
+  p = enc->_out + enc->_out_len;
+  if (type < 0)
+  {
+    gps_codec_type *t = &model->types[model->type_count];
+    memset(t, 0, sizeof(*t));
+    memcpy(t->name, line, field_len[0]);
+    t->name_len = (byte)field_len[0];
+    type = model->type_count++;
+    *p++ = OP_NEW_TYPE;
+    *p++ = t->name_len;
+    memcpy(p, t->name, t->name_len);
+    p += t->name_len;
+  }
+  else
+  {
+    *p++ = (byte)type;
+  }
+
+  for (i = 1; i < field_count; ++i)
+  {
+    gps_codec_column *col = &model->types[type].columns[i - 1];
+    const char *text = line + field_start[i];
+    size_t n = field_len[i];
+    int64_t value;
+    unsigned short format;
+
+    if (n == 0)
+      *p++ = OP_EMPTY;
+    else if (col->text_len == n && memcmp(col->text, text, n) == 0)
+      *p++ = OP_SAME;
+    else if (parse_number(text, n, &value, &format))
+    {
+      int64_t delta = value - col->value;
+      if (format != col->format)
+      {
+        *p++ = OP_NUM_FORMAT;
+        p = put_varint(p, format);
+        p = put_varint(p, zigzag(delta));
+      }
+      else if (delta >= SMALL_DELTA_MIN && delta <= SMALL_DELTA_MAX)
+      {
+        *p++ = (byte)(OP_SMALL_DELTA_ZERO + delta);
+      }
+      else if (varint_length(zigzag(delta - col->delta)) < varint_length(zigzag(delta)))
+      {
+        // steady motion: lat/lon and counters move by about the same each time
+        *p++ = OP_NUM_TREND;
+        p = put_varint(p, zigzag(delta - col->delta));
+      }
+      else
+      {
+        *p++ = OP_NUM;
+        p = put_varint(p, zigzag(delta));
+      }
+      col->value = value;
+      col->delta = delta;
+      col->format = format;
+    }
+    else
+    {
+      *p++ = OP_TEXT;
+      *p++ = (byte)n;
+      memcpy(p, text, n);
+      p += n;
+    }
+    remember_text(col, text, n);
+  }
+  *p++ = crlf ? OP_END : OP_END_LF;
+
+  enc->_out_len = (size_t)(p - enc->_out);
+  enc->_sentences++;
+  return 1;
+}
+
+static int end_line(gps_codec_encoder *enc, gps_codec_sink sink, void *ctx)
+{
+  int coded = encode_sentence(enc, sink, ctx);
+
+  if (coded < 0)
+    return -1;
+  if (coded == 0)
+    return abandon_line(enc, sink, ctx);
+  enc->_in_line = false;
+  return 0;
+}
+
+int gps_codec_encode(gps_codec_encoder *enc, const void *data, size_t len,
+  gps_codec_sink sink, void *ctx)
+{
+  const char *p = data, *end = p + len;
+
+  if (!enc->_started)
+  {
+    memcpy(enc->_out + enc->_out_len, codec_magic, sizeof(codec_magic));
+    enc->_out_len += sizeof(codec_magic);
+    enc->_started = true;
+  }
+
+  while (p < end)
+  {
+    if (!enc->_in_line)
+    {
+      // literal bytes up to the next '$'
+      const char *dollar = memchr(p, '$', (size_t)(end - p));
+      const char *stop = dollar ? dollar : end;
+      if (add_raw(enc, p, (size_t)(stop - p), sink, ctx) != 0)
+        return -1;
+      p = stop;
+      if (p == end)
+        break;
+      ++p;
+      enc->_in_line = true;
+      enc->_line_len = 0;
+      continue;
+    }
+
+    // runs of ordinary characters, classified as tinygps does
+    while (p < end && gps_char_class[(byte)*p] == GPS_CC_ORDINARY && enc->_line_len < sizeof(enc->_line))
+      enc->_line[enc->_line_len++] = *p++;
+    if (p == end)
+      break;
+
+    if (enc->_line_len == sizeof(enc->_line))
+    {
+      if (abandon_line(enc, sink, ctx) != 0)
+        return -1;
+    }
+    else if (*p == '$')
+    {
+      // a new sentence before this one ended
+      if (abandon_line(enc, sink, ctx) != 0)
+        return -1;
+    }
+    else
+    {
+      enc->_line[enc->_line_len++] = *p++;
+      if (p[-1] == '\n' && end_line(enc, sink, ctx) != 0)
+        return -1;
+    }
+  }
+  return 0;
+}
+
+int gps_codec_encode_finish(gps_codec_encoder *enc, gps_codec_sink sink, void *ctx)
+{
+  if (!enc->_started && gps_codec_encode(enc, NULL, 0, sink, ctx) != 0)
+    return -1;
+  if (enc->_in_line && abandon_line(enc, sink, ctx) != 0)
+    return -1;
+  if (emit_raw(enc, sink, ctx) != 0)
+    return -1;
+  return flush_out(enc->_out, &enc->_out_len, sink, ctx);
+}
+
+// ---- decoder ----
+
+void gps_codec_decoder_init(gps_codec_decoder *dec)
+{
+  memset(dec, 0, sizeof(*dec));
+}
+
+// Decodes one record from [p, end) into the output buffer. The model is only
+// changed once the whole record is known to be present. Returns the bytes
+// used, 0 if the record is incomplete, or -1 if it is corrupt
+static long decode_record(gps_codec_decoder *dec, const byte *p, const byte *end)
+{
+  const byte *start = p;
+  gps_codec_model *model = &dec->_model;
+  gps_codec_type new_type;
+  const gps_codec_type *type;
+  gps_codec_column next[GPS_CODEC_COLUMNS];
+  char line[BODY_MAX];
+  size_t line_len = 0, fields = 0, i;
+  byte parity = 0, op;
+  gps_codec_type *target;
+  byte *o;
+  uint64_t v;
+  size_t n;
+  long got;
+
+  if (p == end)
+    return 0;
+  op = *p++;
+
+  if (op == OP_RAW)
+  {
+    if ((got = get_varint(p, end, &v)) <= 0)
+      return got;
+    p += got;
+    if (v == 0 || v > GPS_CODEC_RAW_MAX)
+      return -1;
+    if ((size_t)(end - p) < v)
+      return 0;
+    memcpy(dec->_out + dec->_out_len, p, (size_t)v);
+    dec->_out_len += (size_t)v;
+    return (long)(p + v - start);
+  }
+
+  if (op == OP_NEW_TYPE)
+  {
+    if (model->type_count == GPS_CODEC_TYPES)
+      return -1;
+    if (p == end)
+      return 0;
+    n = *p++;
+    if (n == 0 || n > GPS_CODEC_NAME_MAX)
+      return -1;
+    if ((size_t)(end - p) < n)
+      return 0;
+    memset(&new_type, 0, sizeof(new_type));
+    memcpy(new_type.name, p, n);
+    new_type.name_len = (byte)n;
+    p += n;
+    type = &new_type;
+  }
+  else if (op < model->type_count)
+  {
+    type = &model->types[op];
+  }
+  else
+  {
+    return -1;
+  }
+
+  memcpy(line, type->name, type->name_len);
+  line_len = type->name_len;
+
+  for (;;)
+  {
+    const gps_codec_column *col;
+    gps_codec_column *out;
+    char *text;
+    size_t text_len;
+
+    if (p == end)
+      return 0;
+    op = *p++;
+    if (op == OP_END || op == OP_END_LF)
+      break;
+    if (fields == GPS_CODEC_COLUMNS || line_len == BODY_MAX)
+      return -1;
+    col = &type->columns[fields];
+    out = &next[fields++];
+    *out = *col;
+    line[line_len++] = ',';
+    text = line + line_len;
+
+    if (op == OP_EMPTY)
+    {
+      text_len = 0;
+    }
+    else if (op == OP_SAME)
+    {
+      text_len = col->text_len;
+      if (text_len == 0xFF || line_len + text_len > BODY_MAX)
+        return -1;
+      memcpy(text, col->text, text_len);
+    }
+    else if (op == OP_TEXT)
+    {
+      if (p == end)
+        return 0;
+      text_len = *p++;
+      if (line_len + text_len > BODY_MAX)
+        return -1;
+      if ((size_t)(end - p) < text_len)
+        return 0;
+      memcpy(text, p, text_len);
+      p += text_len;
+    }
+    else
+    {
+      int64_t delta;
+
+      if (op == OP_NUM_FORMAT)
+      {
+        if ((got = get_varint(p, end, &v)) <= 0)
+          return got;
+        p += got;
+        if (!valid_format(v))
+          return -1;
+        out->format = (unsigned short)v;
+      }
+      else if (col->format == 0)
+      {
+        return -1;
+      }
+      if (op == OP_NUM_FORMAT || op == OP_NUM || op == OP_NUM_TREND)
+      {
+        if ((got = get_varint(p, end, &v)) <= 0)
+          return got;
+        p += got;
+        delta = unzigzag(v);
+        if (op == OP_NUM_TREND)
+          delta = (int64_t)((uint64_t)delta + (uint64_t)col->delta);
+      }
+      else
+      {
+        delta = (int64_t)op - OP_SMALL_DELTA_ZERO;
+      }
+      out->value = (int64_t)((uint64_t)col->value + (uint64_t)delta);
+      out->delta = delta;
+      if (!number_fits(out->value, out->format) || line_len + number_length(out->format) > BODY_MAX)
+        return -1;
+      text_len = render_number(out->value, out->format, text);
+    }
+
+    line_len += text_len;
+    remember_text(out, text, text_len);
+  }
+
+  // the whole record is here: rebuild the sentence and commit the model
+  for (i = 0; i < line_len; ++i)
+    parity ^= (byte)line[i];
+  o = dec->_out + dec->_out_len;
+  *o++ = '$';
+  memcpy(o, line, line_len);
+  o += line_len;
+  *o++ = '*';
+  *o++ = (byte)hex_digits[parity >> 4];
+  *o++ = (byte)hex_digits[parity & 0xF];
+  if (op == OP_END)
+    *o++ = '\r';
+  *o++ = '\n';
+  dec->_out_len = (size_t)(o - dec->_out);
+
+  if (type == &new_type)
+  {
+    target = &model->types[model->type_count++];
+    *target = new_type;
+  }
+  else
+  {
+    target = &model->types[type - model->types];
+  }
+  memcpy(target->columns, next, fields * sizeof(next[0]));
+  return (long)(p - start);
+}
+
+// decodes whole records from [p, end); returns the bytes used or -1
+static long decode_records(gps_codec_decoder *dec, const byte *p, const byte *end,
+  gps_codec_sink sink, void *ctx)
+{
+  const byte *start = p;
+  long used;
+
+  while (p < end)
+  {
+    if (dec->_out_len + GPS_CODEC_RECORD_MAX > sizeof(dec->_out) &&
+        flush_out(dec->_out, &dec->_out_len, sink, ctx) != 0)
+      return -1;
+    used = decode_record(dec, p, end);
+    if (used < 0)
+      return -1;
+    if (used == 0)
+      break;
+    p += used;
+  }
+  return (long)(p - start);
+}
+
+int gps_codec_decode(gps_codec_decoder *dec, const void *data, size_t len,
+  gps_codec_sink sink, void *ctx)
+{
+  const byte *p = data, *end = p + len;
+  long used;
+
+  while (dec->_header_seen < sizeof(codec_magic) && p < end)
+    if (*p++ != codec_magic[dec->_header_seen++])
+      return -1;
+
+  // finish the record left over from the previous call
+  if (dec->_pending_len != 0)
+  {
+    size_t held = dec->_pending_len;
+    size_t take = sizeof(dec->_pending) - held;
+    if (take > (size_t)(end - p))
+      take = (size_t)(end - p);
+    memcpy(dec->_pending + held, p, take);
+    used = decode_records(dec, dec->_pending, dec->_pending + held + take, sink, ctx);
+    if (used < 0)
+      return -1;
+    if ((size_t)used < held)
+    {
+      // still incomplete, so everything was taken in
+      if (held + take == sizeof(dec->_pending))
+        return -1;
+      dec->_pending_len = held + take;
+      return 0;
+    }
+    // records from the pending buffer may run into the new data; carry on after them
+    p += (size_t)used - held;
+    dec->_pending_len = 0;
+  }
+
+  used = decode_records(dec, p, end, sink, ctx);
+  if (used < 0)
+    return -1;
+  p += used;
+  // an unfinished record longer than any valid one is corrupt
+  if ((size_t)(end - p) > sizeof(dec->_pending))
+    return -1;
+  memcpy(dec->_pending, p, (size_t)(end - p));
+  dec->_pending_len = (size_t)(end - p);
+  return 0;
+}
+
+int gps_codec_decode_finish(gps_codec_decoder *dec, gps_codec_sink sink, void *ctx)
+{
+  if (flush_out(dec->_out, &dec->_out_len, sink, ctx) != 0)
+    return -1;
+  return dec->_pending_len == 0 && dec->_header_seen == sizeof(codec_magic) ? 0 : -1;
+}
@@ -0,0 +1,96 @@
+/*
+gps_nmea_codec - lossless, field-aware compression of raw NMEA captures.
+
+Each well-formed sentence ("$" type "," fields "*" checksum "\r\n" or "\n",
+with a correct upper-case checksum) is coded against the previous sentence
+of the same type: a field equal to the one in the same column last time
+costs one byte, a number costs one byte when its format is unchanged and it
+moved by a small amount, a steadily changing number (position while moving)
+is coded as the change in its step, and the checksum and line ending are
+dropped because they can be recomputed. Everything else (noise, broken or
+truncated sentences) is carried as literal bytes, so decoding reproduces
+the input exactly.
+
+Both directions stream: feed any split of the input and output goes to the
+sink as it is produced. Encoder and decoder state are plain structs with no
+allocation; the output is byte-oriented and can be handed to a general
+purpose compressor for a further gain.
+*/
+
+#ifndef gps_nmea_codec_h
+#define gps_nmea_codec_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tinygps.h"
+
+#define GPS_CODEC_TYPES 32           // sentence types tracked; others are coded as literals
+#define GPS_CODEC_COLUMNS 24         // fields per sentence
+#define GPS_CODEC_NAME_MAX 8         // sentence type, e.g. "GPRMC" or "PSRF103"
+#define GPS_CODEC_FIELD_MAX 15       // longest field remembered for repeats
+#define GPS_CODEC_LINE_MAX 128       // longest sentence coded structurally
+#define GPS_CODEC_RAW_MAX 256        // literal bytes per record
+#define GPS_CODEC_RECORD_MAX 512     // upper bound on one coded record
+#define GPS_CODEC_OUT_SIZE 4096
+
+  // receives output; returns 0 on success
+  typedef int (*gps_codec_sink)(void *ctx, const void *data, size_t len);
+
+  typedef struct gps_codec_column {
+    int64_t value;                   // last number, all digits as an integer
+    int64_t delta;                   // how far it moved from the one before
+    unsigned short format;           // and how it was written; 0 if never numeric
+    byte text_len;                   // 0xFF if the last field was too long to keep
+    char text[GPS_CODEC_FIELD_MAX];
+  } gps_codec_column;
+
+  typedef struct gps_codec_type {
+    char name[GPS_CODEC_NAME_MAX];
+    byte name_len;
+    gps_codec_column columns[GPS_CODEC_COLUMNS];
+  } gps_codec_type;
+
+  // what encoder and decoder both learn from the stream
+  typedef struct gps_codec_model {
+    gps_codec_type types[GPS_CODEC_TYPES];
+    byte type_count;
+  } gps_codec_model;
+
+  typedef struct gps_codec_encoder {
+    gps_codec_model _model;
+    char _line[GPS_CODEC_LINE_MAX];  // sentence being collected
+    size_t _line_len;
+    bool _in_line;
+    byte _raw[GPS_CODEC_RAW_MAX];    // literal bytes not yet written
+    size_t _raw_len;
+    byte _out[GPS_CODEC_OUT_SIZE];
+    size_t _out_len;
+    bool _started;                   // stream header written
+    unsigned long _sentences;        // coded structurally
+    unsigned long _literal_bytes;
+  } gps_codec_encoder;
+
+  typedef struct gps_codec_decoder {
+    gps_codec_model _model;
+    byte _pending[GPS_CODEC_RECORD_MAX];  // incomplete record carried between calls
+    size_t _pending_len;
+    byte _out[GPS_CODEC_OUT_SIZE];
+    size_t _out_len;
+    byte _header_seen;               // bytes of the stream header checked so far
+  } gps_codec_decoder;
+
+  void gps_codec_encoder_init(gps_codec_encoder *enc);
+  // returns 0, or -1 if the sink failed
+  int gps_codec_encode(gps_codec_encoder *enc, const void *data, size_t len,
+    gps_codec_sink sink, void *ctx);
+  // writes out everything held back; call once at the end of the input
+  int gps_codec_encode_finish(gps_codec_encoder *enc, gps_codec_sink sink, void *ctx);
+
+  void gps_codec_decoder_init(gps_codec_decoder *dec);
+  // returns 0, or -1 if the input is corrupt or the sink failed
+  int gps_codec_decode(gps_codec_decoder *dec, const void *data, size_t len,
+    gps_codec_sink sink, void *ctx);
+  // returns -1 if the input ended inside a record
+  int gps_codec_decode_finish(gps_codec_decoder *dec, gps_codec_sink sink, void *ctx);
+
+#endif
@@ -0,0 +1,223 @@
+/*
+gps_nmea_out - NMEA 0183 sentence encoder. See gps_nmea_out.h.
+*/
+
+#include "gps_nmea_out.h"
+
+// cursor over the caller's buffer; parity covers everything after the '$'
+typedef struct nmea_writer {
+  char *p;
+  char *end;
+  byte parity;
+  bool overflow;
+} nmea_writer;
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static void put_char(nmea_writer *w, char c)
+{
+  if (w->p == w->end)
+  {
+    w->overflow = true;
+    return;
+  }
+  *w->p++ = c;
+  w->parity ^= (byte)c;
+}
+
+static void put_str(nmea_writer *w, const char *s)
+{
+  while (*s)
+    put_char(w, *s++);
+}
+
+// decimal with at least min_digits digits, zero padded
+static void put_uint(nmea_writer *w, unsigned long value, int min_digits)
+{
+  char digits[10];
+  int n = 0;
+
+  do
+  {
+    digits[n++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  while (n < min_digits)
+    digits[n++] = '0';
+  while (n > 0)
+    put_char(w, digits[--n]);
+}
+
+// value in 100ths as "i.ff"
+static void put_hundredths(nmea_writer *w, unsigned long value)
+{
+  put_uint(w, value / 100, 1);
+  put_char(w, '.');
+  put_uint(w, value % 100, 2);
+}
+
+static void put_signed_hundredths(nmea_writer *w, long value)
+{
+  if (value < 0)
+  {
+    put_char(w, '-');
+    value = -value;
+  }
+  put_hundredths(w, (unsigned long)value);
+}
+
+// gps_fix angle units as [d]ddmm.mmmmmm,H
+static void put_angle(nmea_writer *w, long angle, int degree_digits, char positive, char negative)
+{
+  static const unsigned long minute_units[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+  const unsigned long per_minute = minute_units[GPS_NMEA_MINUTE_DECIMALS];
+  unsigned long magnitude = angle < 0 ? (unsigned long)-angle : (unsigned long)angle;
+  // fractions of a minute, rounded; carries into minutes and degrees
+  unsigned long long minutes = ((unsigned long long)magnitude * 60 * per_minute + GPS_ANGLE_SCALE / 2) / GPS_ANGLE_SCALE;
+  unsigned long whole = (unsigned long)(minutes / per_minute);
+
+  put_uint(w, whole / 60, degree_digits);
+  put_uint(w, whole % 60, 2);
+  put_char(w, '.');
+  put_uint(w, (unsigned long)(minutes % per_minute), GPS_NMEA_MINUTE_DECIMALS);
+  put_char(w, ',');
+  put_char(w, angle < 0 ? negative : positive);
+}
+
+static void put_position(nmea_writer *w, const gps_fix *fix)
+{
+  if (fix->latitude == GPS_INVALID_ANGLE)
+  {
+    put_str(w, ",,,");
+    return;
+  }
+  put_angle(w, fix->latitude, 2, 'N', 'S');
+  put_char(w, ',');
+  put_angle(w, fix->longitude, 3, 'E', 'W');
+}
+
+// hhmmss.cc
+static void put_time(nmea_writer *w, unsigned long time)
+{
+  if (time == GPS_INVALID_TIME)
+    return;
+  put_uint(w, time / 100, 6);
+  put_char(w, '.');
+  put_uint(w, time % 100, 2);
+}
+
+static void begin(nmea_writer *w, char *buf, size_t len, const char *type)
+{
+  w->p = buf;
+  w->end = buf + (len < GPS_NMEA_MAX_SENTENCE ? len : GPS_NMEA_MAX_SENTENCE);
+  w->overflow = false;
+  put_char(w, '$');
+  w->parity = 0;
+  put_str(w, type);
+}
+
+static size_t finish(nmea_writer *w, char *buf)
+{
+  byte parity = w->parity;
+
+  put_char(w, '*');
+  put_char(w, hex_digits[parity >> 4]);
+  put_char(w, hex_digits[parity & 0xF]);
+  put_char(w, '\r');
+  put_char(w, '\n');
+  return w->overflow ? 0 : (size_t)(w->p - buf);
+}
+
+static bool has_position(const gps_fix *fix)
+{
+  return fix->latitude != GPS_INVALID_ANGLE;
+}
+
+size_t gps_nmea_rmc(const gps_fix *fix, char *buf, size_t len)
+{
+  nmea_writer w;
+
+  begin(&w, buf, len, "GPRMC,");
+  put_time(&w, fix->time);
+  put_str(&w, has_position(fix) ? ",A," : ",V,");
+  put_position(&w, fix);
+  put_char(&w, ',');
+  if (fix->speed != GPS_INVALID_SPEED)
+    put_hundredths(&w, fix->speed);
+  put_char(&w, ',');
+  if (fix->course != GPS_INVALID_ANGLE)
+    put_hundredths(&w, fix->course);
+  put_char(&w, ',');
+  if (fix->date != GPS_INVALID_DATE)
+    put_uint(&w, fix->date, 6);
+  put_str(&w, ",,");                  // no magnetic variation
+  return finish(&w, buf);
+}
+
+size_t gps_nmea_gga(const gps_fix *fix, char *buf, size_t len)
+{
+  nmea_writer w;
+
+  begin(&w, buf, len, "GPGGA,");
+  put_time(&w, fix->time);
+  put_char(&w, ',');
+  put_position(&w, fix);
+  put_char(&w, ',');
+  if (!has_position(fix))
+    put_char(&w, '0');
+  else if (fix->quality != GPS_INVALID_QUALITY)
+    put_uint(&w, fix->quality, 1);
+  else
+    put_char(&w, '1');               // position from RMC alone: a plain GPS fix
+  put_char(&w, ',');
+  if (fix->numsats != GPS_INVALID_SATELLITES)
+    put_uint(&w, fix->numsats, 2);
+  put_char(&w, ',');
+  if (fix->hdop != GPS_INVALID_HDOP)
+    put_hundredths(&w, fix->hdop);
+  put_char(&w, ',');
+  if (fix->altitude != GPS_INVALID_ALTITUDE)
+    put_signed_hundredths(&w, fix->altitude);
+  put_str(&w, ",M,,M,,");             // no geoid separation or differential data
+  return finish(&w, buf);
+}
+
+size_t gps_nmea_vtg(const gps_fix *fix, char *buf, size_t len)
+{
+  nmea_writer w;
+
+  begin(&w, buf, len, "GPVTG,");
+  if (fix->course != GPS_INVALID_ANGLE)
+    put_hundredths(&w, fix->course);
+  put_str(&w, ",T,,M,");
+  if (fix->speed != GPS_INVALID_SPEED)
+  {
+    put_hundredths(&w, fix->speed);
+    put_str(&w, ",N,");
+    // 1 knot = 1.852 km/h, rounded to 100ths
+    put_hundredths(&w, (unsigned long)(((unsigned long long)fix->speed * 1852 + 500) / 1000));
+    put_str(&w, ",K");
+  }
+  else
+  {
+    put_str(&w, ",N,,K");
+  }
+  return finish(&w, buf);
+}
+
+size_t gps_nmea_write_fix(const gps_fix *fix, unsigned mask, gps_nmea_sink sink, void *ctx)
+{
+  char buf[3 * GPS_NMEA_MAX_SENTENCE];
+  size_t used = 0;
+
+  if (mask & GPS_NMEA_RMC)
+    used += gps_nmea_rmc(fix, buf + used, sizeof(buf) - used);
+  if (mask & GPS_NMEA_GGA)
+    used += gps_nmea_gga(fix, buf + used, sizeof(buf) - used);
+  if (mask & GPS_NMEA_VTG)
+    used += gps_nmea_vtg(fix, buf + used, sizeof(buf) - used);
+
+  if (used == 0 || sink(ctx, buf, used) != 0)
+    return 0;
+  return used;
+}
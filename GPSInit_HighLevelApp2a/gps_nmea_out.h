@@ -0,0 +1,44 @@
+/*
+gps_nmea_out - renders a gps_fix as NMEA 0183 sentences (RMC, GGA, VTG)
+for equipment that only understands NMEA.
+
+Formatting is integer-only and the checksum is accumulated as characters
+are written, so a sentence costs one pass over its ~70 bytes. Fields the
+fix does not have (GPS_INVALID_*) are left empty, as receivers do.
+*/
+
+#ifndef gps_nmea_out_h
+#define gps_nmea_out_h
+
+#include <stddef.h>
+#include "tinygps.h"
+
+#define GPS_NMEA_MAX_SENTENCE 82     // "$" through "\r\n", per NMEA 0183
+
+// decimals of a minute in latitude/longitude; 6 round-trips the 10^-7 degree
+// fix exactly, 4 matches what older receivers send
+#ifndef GPS_NMEA_MINUTE_DECIMALS
+#define GPS_NMEA_MINUTE_DECIMALS 6
+#endif
+
+  enum {
+    GPS_NMEA_RMC = 1,
+    GPS_NMEA_GGA = 2,
+    GPS_NMEA_VTG = 4
+  };
+
+  // Each renders one sentence including "\r\n" into buf (no terminating NUL)
+  // and returns its length, or 0 if it does not fit in len bytes
+  size_t gps_nmea_rmc(const gps_fix *fix, char *buf, size_t len);
+  size_t gps_nmea_gga(const gps_fix *fix, char *buf, size_t len);
+  size_t gps_nmea_vtg(const gps_fix *fix, char *buf, size_t len);
+
+  // receives rendered output; returns 0 on success
+  typedef int (*gps_nmea_sink)(void *ctx, const void *data, size_t len);
+
+  // Render the sentences selected by mask (GPS_NMEA_*) in RMC, GGA, VTG order
+  // and hand them to sink in a single call, so an epoch is never split.
+  // Returns the bytes passed to sink, or 0 if nothing was written
+  size_t gps_nmea_write_fix(const gps_fix *fix, unsigned mask, gps_nmea_sink sink, void *ctx);
+
+#endif
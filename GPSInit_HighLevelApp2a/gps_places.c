@@ -0,0 +1,228 @@
+/*
+gps_places - fixed-capacity spatial index of reference points.
+See gps_places.h.
+*/
+
+#include <math.h>
+#include "gps_places.h"
+
+// north-south extent of one cell in meters
+#define CELL_HEIGHT_M ((float)GPS_PLACES_CELL / GPS_ANGLE_SCALE * (PI / 180) * GPS_EARTH_RADIUS_M)
+
+// cells around a circle of latitude; column indexes wrap modulo this, so the
+// cells either side of the antimeridian are neighbours
+#define CELL_COLUMNS (360 * (GPS_ANGLE_SCALE / GPS_PLACES_CELL))
+
+static long cell_of(long v)
+{
+  return v >= 0 ? v / GPS_PLACES_CELL : -((-v + GPS_PLACES_CELL - 1) / GPS_PLACES_CELL);
+}
+
+// column index wrapped into [-CELL_COLUMNS / 2, CELL_COLUMNS / 2)
+static long column_wrap(long column)
+{
+  column %= CELL_COLUMNS;
+  if (column < -CELL_COLUMNS / 2)
+    column += CELL_COLUMNS;
+  else if (column >= CELL_COLUMNS / 2)
+    column -= CELL_COLUMNS;
+  return column;
+}
+
+static unsigned bucket_of(long cell_lat, long cell_lon)
+{
+  return ((unsigned long)cell_lat * 73856093UL ^ (unsigned long)cell_lon * 19349663UL)
+    & (GPS_PLACES_BUCKETS - 1);
+}
+
+// east-west extent of a cell in meters at the most poleward latitude of a
+// band extending cells either side of latitude
+static float cell_width_m(long latitude, long cells)
+{
+  float lat = fabsf((float)latitude / GPS_ANGLE_SCALE) + cells * ((float)GPS_PLACES_CELL / GPS_ANGLE_SCALE);
+  if (lat >= 90)
+    return 0;
+  return CELL_HEIGHT_M * cosf(lat * (PI / 180));
+}
+
+static float place_distance(const gps_places *idx, int i, long latitude, long longitude)
+{
+  return gps_fast_distance_between((float)latitude / GPS_ANGLE_SCALE, (float)longitude / GPS_ANGLE_SCALE,
+    (float)idx->_latitude[i] / GPS_ANGLE_SCALE, (float)idx->_longitude[i] / GPS_ANGLE_SCALE);
+}
+
+// insert into hits[0..*n) kept sorted by distance, dropping the farthest
+// once cap entries are held
+static void hit_insert(gps_place_hit *hits, int *n, int cap, int id, float distance)
+{
+  int i;
+
+  if (*n == cap && distance >= hits[cap - 1].distance)
+    return;
+  i = *n < cap ? (*n)++ : cap - 1;
+  for (; i > 0 && hits[i - 1].distance > distance; --i)
+    hits[i] = hits[i - 1];
+  hits[i].id = id;
+  hits[i].distance = distance;
+}
+
+static void scan_cell(const gps_places *idx, long cell_lat, long cell_lon,
+  long latitude, long longitude, float radius, gps_place_hit *hits, int *n, int cap)
+{
+  int i;
+
+  for (i = idx->_bucket[bucket_of(cell_lat, cell_lon)]; i >= 0; i = idx->_next[i])
+  {
+    if (idx->_cell_lat[i] != cell_lat || idx->_cell_lon[i] != cell_lon)
+      continue;
+    float d = place_distance(idx, i, latitude, longitude);
+    if (d <= radius)
+      hit_insert(hits, n, cap, i, d);
+  }
+}
+
+static int scan_all(const gps_places *idx, long latitude, long longitude,
+  float radius, gps_place_hit *hits, int cap)
+{
+  int i, n = 0;
+
+  for (i = 0; i < GPS_PLACES_MAX; ++i)
+  {
+    if (!idx->_used[i])
+      continue;
+    float d = place_distance(idx, i, latitude, longitude);
+    if (d <= radius)
+      hit_insert(hits, &n, cap, i, d);
+  }
+  return n;
+}
+
+static void unlink_place(gps_places *idx, int id)
+{
+  signed char *link = &idx->_bucket[bucket_of(idx->_cell_lat[id], idx->_cell_lon[id])];
+
+  while (*link != id)
+    link = &idx->_next[(int)*link];
+  *link = idx->_next[id];
+}
+
+void gps_places_init(gps_places *idx)
+{
+  int i;
+
+  for (i = 0; i < GPS_PLACES_BUCKETS; ++i)
+    idx->_bucket[i] = -1;
+  for (i = 0; i < GPS_PLACES_MAX; ++i)
+  {
+    idx->_used[i] = false;
+    idx->_next[i] = -1;
+  }
+  idx->_count = 0;
+}
+
+int gps_places_set(gps_places *idx, int id, long latitude, long longitude)
+{
+  long cell_lat, cell_lon;
+
+  if (id < 0 || id >= GPS_PLACES_MAX)
+    return -1;
+
+  cell_lat = cell_of(latitude);
+  cell_lon = column_wrap(cell_of(longitude));
+  idx->_latitude[id] = latitude;
+  idx->_longitude[id] = longitude;
+
+  if (idx->_used[id])
+  {
+    // moves within the same cell leave the bucket chain alone
+    if (idx->_cell_lat[id] == cell_lat && idx->_cell_lon[id] == cell_lon)
+      return 0;
+    unlink_place(idx, id);
+  }
+  else
+  {
+    idx->_used[id] = true;
+    ++idx->_count;
+  }
+
+  unsigned b = bucket_of(cell_lat, cell_lon);
+  idx->_cell_lat[id] = cell_lat;
+  idx->_cell_lon[id] = cell_lon;
+  idx->_next[id] = idx->_bucket[b];
+  idx->_bucket[b] = (signed char)id;
+  return 0;
+}
+
+int gps_places_remove(gps_places *idx, int id)
+{
+  if (id < 0 || id >= GPS_PLACES_MAX || !idx->_used[id])
+    return -1;
+
+  unlink_place(idx, id);
+  idx->_used[id] = false;
+  idx->_next[id] = -1;
+  --idx->_count;
+  return 0;
+}
+
+int gps_places_nearest(const gps_places *idx, long latitude, long longitude,
+  gps_place_hit *hits, int k)
+{
+  long qlat = cell_of(latitude), qlon = cell_of(longitude);
+  int n = 0, r;
+
+  if (k <= 0 || idx->_count == 0)
+    return 0;
+
+  // walk square rings of cells outward from the query cell. Every point in
+  // ring r+1 is at least r whole cells away, so once k hits are held and the
+  // farthest of them is inside that bound no further ring can improve on them
+  for (r = 0; r <= GPS_PLACES_MAX_RING; ++r)
+  {
+    long dl, dn;
+    for (dl = -r; dl <= r; ++dl)
+      for (dn = -r; dn <= r; dn += (dl == -r || dl == r) ? 1 : 2 * r)
+      {
+        scan_cell(idx, qlat + dl, column_wrap(qlon + dn), latitude, longitude, INFINITY, hits, &n, k);
+        if (r == 0)
+          break;
+      }
+
+    if (n == idx->_count)
+      return n;
+    if (n == k)
+    {
+      float bound = r * fminf(CELL_HEIGHT_M, cell_width_m(latitude, r + 1));
+      if (hits[k - 1].distance <= bound)
+        return n;
+    }
+  }
+
+  // sparse neighbourhood
+  return scan_all(idx, latitude, longitude, INFINITY, hits, k);
+}
+
+int gps_places_within(const gps_places *idx, long latitude, long longitude,
+  float radius, gps_place_hit *hits, int max)
+{
+  long qlat = cell_of(latitude), qlon = cell_of(longitude);
+  long rows, cols, dl, dn;
+  float width;
+  int n = 0;
+
+  if (max <= 0 || idx->_count == 0)
+    return 0;
+
+  rows = (long)ceilf(radius / CELL_HEIGHT_M);
+  width = cell_width_m(latitude, rows);
+  cols = width > 0 ? (long)ceilf(radius / width) : GPS_PLACES_MAX;
+
+  // a window covering more cells than there are places is slower than a scan
+  if ((2 * rows + 1) * (2 * cols + 1) > GPS_PLACES_MAX)
+    return scan_all(idx, latitude, longitude, radius, hits, max);
+
+  for (dl = -rows; dl <= rows; ++dl)
+    for (dn = -cols; dn <= cols; ++dn)
+      scan_cell(idx, qlat + dl, column_wrap(qlon + dn), latitude, longitude, radius, hits, &n, max);
+  return n;
+}
@@ -0,0 +1,56 @@
+/*
+gps_places - fixed-capacity spatial index of reference points (depots,
+waypoints, other devices) answering "which are nearest to this fix" and
+"which are within this radius" without scanning the whole set.
+
+Points are bucketed into a grid of GPS_PLACES_CELL-sized cells hashed into
+GPS_PLACES_BUCKETS lists, so inserting or moving a point is O(1) plus the
+length of one bucket and the index never needs rebuilding. No memory is
+allocated; the whole index is a single struct.
+*/
+
+#ifndef gps_places_h
+#define gps_places_h
+
+#include "tinygps.h"
+
+#define GPS_PLACES_MAX 64           // capacity; place ids are 0..GPS_PLACES_MAX-1
+#define GPS_PLACES_BUCKETS 32       // grid hash buckets, power of two
+#define GPS_PLACES_CELL (GPS_ANGLE_SCALE / 10)  // cell edge in gps_fix angle units (0.1 deg)
+#define GPS_PLACES_MAX_RING 8       // nearest() falls back to a full scan past this ring
+
+  typedef struct gps_place_hit {
+    int id;
+    float distance;                 // meters, from gps_fast_distance_between()
+  } gps_place_hit;
+
+  typedef struct gps_places {
+    long _latitude[GPS_PLACES_MAX]; // gps_fix units, 10^-7 degree
+    long _longitude[GPS_PLACES_MAX];
+    long _cell_lat[GPS_PLACES_MAX];
+    long _cell_lon[GPS_PLACES_MAX];
+    signed char _next[GPS_PLACES_MAX];        // bucket chain, -1 terminates
+    signed char _bucket[GPS_PLACES_BUCKETS];  // chain heads
+    bool _used[GPS_PLACES_MAX];
+    int _count;
+  } gps_places;
+
+  void gps_places_init(gps_places *idx);
+
+  // insert place id at lat/long, or move it there if already present.
+  // Returns 0 on success, -1 if id is out of range
+  int gps_places_set(gps_places *idx, int id, long latitude, long longitude);
+
+  // remove place id; returns 0 if it was present, -1 otherwise
+  int gps_places_remove(gps_places *idx, int id);
+
+  // up to k places nearest to lat/long, closest first; returns the number found
+  int gps_places_nearest(const gps_places *idx, long latitude, long longitude,
+    gps_place_hit *hits, int k);
+
+  // up to max places within radius meters of lat/long, closest first;
+  // returns the number found
+  int gps_places_within(const gps_places *idx, long latitude, long longitude,
+    float radius, gps_place_hit *hits, int max);
+
+#endif
@@ -0,0 +1,183 @@
+/*
+gps_query - zone-map pruned queries over gps_columns files. See gps_query.h.
+*/
+
+#include <string.h>
+#include "gps_query.h"
+#include "gps_geo.h"
+
+void gps_query_init(gps_query *q)
+{
+  q->has_time = false;
+  q->has_area = false;
+  q->_cell_chars = 0;
+}
+
+void gps_query_time(gps_query *q, int64_t from_ms, int64_t to_ms)
+{
+  q->from_ms = from_ms;
+  q->to_ms = to_ms;
+  q->has_time = true;
+}
+
+void gps_query_area(gps_query *q, long min_latitude, long max_latitude,
+  long min_longitude, long max_longitude)
+{
+  q->min_latitude = min_latitude;
+  q->max_latitude = max_latitude;
+  q->min_longitude = min_longitude;
+  q->max_longitude = max_longitude;
+  q->has_area = true;
+  q->_cell_chars = 0;
+}
+
+bool gps_query_geohash(gps_query *q, const char *hash)
+{
+  uint64_t cell;
+  int chars;
+  long min_lat, max_lat, min_lon, max_lon;
+
+  if (!gps_geohash_parse(hash, &cell, &chars))
+    return false;
+  gps_geohash_bounds(cell, chars, &min_lat, &max_lat, &min_lon, &max_lon);
+  gps_query_area(q, min_lat, max_lat, min_lon, max_lon);
+  return true;
+}
+
+// the cells of the given precision covering the area, or -1 if too many
+static void cover_area(gps_query *q, byte chars)
+{
+  long lat = q->min_latitude, lon, lat_lo, lat_hi, lon_lo, lon_hi;
+
+  q->_cell_chars = chars;
+  q->_cell_count = 0;
+  for (;;)
+  {
+    for (lon = q->min_longitude;;)
+    {
+      uint64_t cell = gps_geohash(lat, lon, chars);
+      if (q->_cell_count == GPS_QUERY_MAX_CELLS)
+      {
+        q->_cell_count = -1;
+        return;
+      }
+      q->_cells[q->_cell_count++] = cell;
+      gps_geohash_bounds(cell, chars, &lat_lo, &lat_hi, &lon_lo, &lon_hi);
+      if (lon_hi >= q->max_longitude)
+        break;
+      lon = lon_hi + 1;
+    }
+    if (lat_hi >= q->max_latitude)
+      return;
+    lat = lat_hi + 1;
+  }
+}
+
+// whether the zone map rules the batch out
+static bool skip_batch(gps_query *q, const gps_columns_zone *zone, gps_query_stats *stats)
+{
+  int i;
+
+  if (q->has_time && (zone->min_time > q->to_ms || zone->max_time < q->from_ms))
+  {
+    stats->skipped_time++;
+    return true;
+  }
+  if (!q->has_area)
+    return false;
+  if (zone->min_latitude > q->max_latitude || zone->max_latitude < q->min_latitude ||
+      zone->min_longitude > q->max_longitude || zone->max_longitude < q->min_longitude)
+  {
+    stats->skipped_box++;
+    return true;
+  }
+
+  if (q->_cell_chars != zone->geohash_chars)
+    cover_area(q, zone->geohash_chars);
+  if (q->_cell_count < 0)
+    return false;
+  for (i = 0; i < q->_cell_count; ++i)
+    if (gps_columns_may_visit(zone, q->_cells[i]))
+      return false;
+  stats->skipped_bloom++;
+  return true;
+}
+
+// sets q->_selected for the rows of batch that match; returns how many
+static size_t select_rows(gps_query *q, const gps_columns_batch *batch)
+{
+  size_t rows = batch->rows, i, matches = 0;
+
+  memset(q->_selected, 0xFF, (rows + 7) / 8);
+  if (q->has_time)
+  {
+    gps_columns_decode(batch, GPS_COL_TIME, q->_time);
+    for (i = 0; i < rows; ++i)
+      if (q->_time[i] < q->from_ms || q->_time[i] > q->to_ms || !gps_columns_is_valid(batch, GPS_COL_TIME, i))
+        q->_selected[i >> 3] &= (byte)~(1 << (i & 7));
+  }
+  if (q->has_area)
+  {
+    gps_columns_decode(batch, GPS_COL_LATITUDE, q->_latitude);
+    gps_columns_decode(batch, GPS_COL_LONGITUDE, q->_longitude);
+    for (i = 0; i < rows; ++i)
+      if (q->_latitude[i] < q->min_latitude || q->_latitude[i] > q->max_latitude ||
+          q->_longitude[i] < q->min_longitude || q->_longitude[i] > q->max_longitude ||
+          !gps_columns_is_valid(batch, GPS_COL_LATITUDE, i))
+        q->_selected[i >> 3] &= (byte)~(1 << (i & 7));
+  }
+  if (!q->has_time && !q->has_area)
+  {
+    // everything with a time or a position
+    for (i = 0; i < rows; ++i)
+      if (!gps_columns_is_valid(batch, GPS_COL_TIME, i) && !gps_columns_is_valid(batch, GPS_COL_LATITUDE, i))
+        q->_selected[i >> 3] &= (byte)~(1 << (i & 7));
+  }
+
+  for (i = 0; i < rows; ++i)
+    matches += q->_selected[i >> 3] >> (i & 7) & 1;
+  return matches;
+}
+
+long gps_query_run(gps_query *q, const void *file, size_t len,
+  gps_query_visit visit, void *ctx, gps_query_stats *stats)
+{
+  gps_query_stats local;
+  gps_columns_zone zone;
+  gps_columns_batch batch;
+  size_t offset, at;
+  long matched = 0;
+  int found;
+
+  if (stats == NULL)
+    stats = &local;
+  memset(stats, 0, sizeof(*stats));
+  if (gps_columns_open(file, len, &offset) != 0)
+    return -1;
+
+  for (;;)
+  {
+    size_t matches;
+
+    at = offset;
+    found = gps_columns_next_zone(file, len, &offset, &zone);
+    if (found <= 0)
+      return found == 0 ? matched : -1;
+    stats->batches++;
+    if (zone.rows > GPS_COLUMNS_BATCH)
+      return -1;
+    if (skip_batch(q, &zone, stats))
+      continue;
+
+    if (gps_columns_next(file, len, &at, &batch) != 1)
+      return -1;
+    stats->rows_scanned += batch.rows;
+    matches = select_rows(q, &batch);
+    if (matches == 0)
+      continue;
+    stats->rows_matched += matches;
+    matched += (long)matches;
+    if (visit != NULL && visit(ctx, &batch, q->_selected, matches) != 0)
+      return matched;
+  }
+}
@@ -0,0 +1,71 @@
+/*
+gps_query - time and area queries over a gps_columns track file that skip
+whole batches using their zone maps.
+
+A batch is opened only if its time range overlaps the query, its bounding
+box overlaps the query area and, for areas of at most GPS_QUERY_MAX_CELLS
+geohash cells, its Bloom filter admits one of the area's cells. Only then
+are the time and position columns decoded and the rows tested; the
+caller gets a bitmap of the matching rows and decodes whatever else it
+needs. "Where was it between t1 and t2" and "was it ever in this area"
+both cost a header read per batch outside the answer.
+*/
+
+#ifndef gps_query_h
+#define gps_query_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "gps_columns.h"
+
+#define GPS_QUERY_MAX_CELLS 64       // larger areas are tested by bounding box alone
+
+  typedef struct gps_query_stats {
+    unsigned long batches;
+    unsigned long skipped_time;      // by the zone map time range
+    unsigned long skipped_box;       // by the zone map bounding box
+    unsigned long skipped_bloom;     // by the geohash Bloom filter
+    unsigned long rows_scanned;      // in batches that were opened
+    unsigned long rows_matched;
+  } gps_query_stats;
+
+  typedef struct gps_query {
+    int64_t from_ms, to_ms;          // inclusive, ms since 1970
+    bool has_time;
+    long min_latitude, max_latitude; // inclusive, gps_fix units
+    long min_longitude, max_longitude;
+    bool has_area;
+
+    // geohash cells covering the area at the precision of the file's zone maps
+    uint64_t _cells[GPS_QUERY_MAX_CELLS];
+    int _cell_count;                 // -1 if the area needs more cells
+    byte _cell_chars;                // precision _cells were computed for, 0 if none
+
+    // decoded columns of the batch being tested
+    int64_t _time[GPS_COLUMNS_BATCH];
+    int64_t _latitude[GPS_COLUMNS_BATCH];
+    int64_t _longitude[GPS_COLUMNS_BATCH];
+    byte _selected[GPS_COLUMNS_BATCH / 8];
+  } gps_query;
+
+  // Called for each batch with matching rows; bit r of selected (LSB
+  // first) is set for each matching row r. Return nonzero to stop early,
+  // e.g. when only existence matters
+  typedef int (*gps_query_visit)(void *ctx, const gps_columns_batch *batch,
+    const byte *selected, size_t matches);
+
+  // a query matching every row with a time or position
+  void gps_query_init(gps_query *q);
+  void gps_query_time(gps_query *q, int64_t from_ms, int64_t to_ms);
+  void gps_query_area(gps_query *q, long min_latitude, long max_latitude,
+    long min_longitude, long max_longitude);
+  // area of a geohash cell; false if hash is not a geohash
+  bool gps_query_geohash(gps_query *q, const char *hash);
+
+  // Run over a whole file (typically mmapped). visit and stats may be NULL.
+  // Returns the rows matched up to any early stop, or -1 if the file is
+  // corrupt or has batches larger than GPS_COLUMNS_BATCH
+  long gps_query_run(gps_query *q, const void *file, size_t len,
+    gps_query_visit visit, void *ctx, gps_query_stats *stats);
+
+#endif
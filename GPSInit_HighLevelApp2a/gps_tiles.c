@@ -0,0 +1,182 @@
+/*
+gps_tiles - streaming density/speed aggregation into z/x/y map tiles.
+See gps_tiles.h.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "gps_tiles.h"
+
+const byte gps_tiles_zoom[GPS_TILES_LEVELS] = { 10, 13, 16 };
+
+// Web Mercator has no tiles beyond this latitude
+#define MERCATOR_MAX_LAT 85.05112878
+
+static unsigned slot_of(unsigned long x, unsigned long y)
+{
+  return (unsigned)((x * 73856093UL) ^ (y * 19349663UL)) & (GPS_TILES_CELLS - 1);
+}
+
+// find the cell for x/y at level, claiming an empty slot if needed
+static gps_tile_cell *find_cell(gps_tiles *tiles, int level, unsigned long x, unsigned long y)
+{
+  gps_tile_cell *cells = tiles->_cells[level];
+  unsigned i = slot_of(x, y), probes;
+
+  for (probes = 0; probes < GPS_TILES_CELLS; ++probes, i = (i + 1) & (GPS_TILES_CELLS - 1))
+  {
+    if (cells[i].count == 0)
+    {
+      if (tiles->_used[level] >= GPS_TILES_CELLS * 3 / 4)
+        return NULL; // keep probe chains short
+      ++tiles->_used[level];
+      cells[i].x = x;
+      cells[i].y = y;
+      return &cells[i];
+    }
+    if (cells[i].x == x && cells[i].y == y)
+      return &cells[i];
+  }
+  return NULL;
+}
+
+static void add_to_cell(gps_tile_cell *cell, unsigned long count,
+  unsigned long speed_count, unsigned long speed_sum, unsigned long speed_max)
+{
+  cell->count += count;
+  cell->speed_count += speed_count;
+  cell->speed_sum += speed_sum;
+  if (speed_max > cell->speed_max)
+    cell->speed_max = speed_max;
+}
+
+void gps_tiles_init(gps_tiles *tiles)
+{
+  memset(tiles, 0, sizeof(*tiles));
+}
+
+void gps_tiles_add(gps_tiles *tiles, const gps_fix *fix)
+{
+  const byte deepest = gps_tiles_zoom[GPS_TILES_LEVELS - 1];
+  double lat, lon, n;
+  unsigned long x, y, speed_count, speed;
+  int level;
+
+  if (fix->latitude == GPS_INVALID_ANGLE)
+    return;
+
+  lat = fix->latitude / (double)GPS_ANGLE_SCALE;
+  lon = fix->longitude / (double)GPS_ANGLE_SCALE;
+  if (lat > MERCATOR_MAX_LAT)
+    lat = MERCATOR_MAX_LAT;
+  else if (lat < -MERCATOR_MAX_LAT)
+    lat = -MERCATOR_MAX_LAT;
+
+  // project once at the deepest zoom; coarser tiles are the same
+  // coordinates shifted right by the zoom difference
+  n = (double)(1UL << deepest);
+  lat *= PI / 180;
+  x = (unsigned long)((lon + 180.0) / 360.0 * n);
+  y = (unsigned long)((1.0 - log(tan(lat) + 1.0 / cos(lat)) / PI) / 2.0 * n);
+  if (x >= (1UL << deepest))
+    x = (1UL << deepest) - 1;
+  if (y >= (1UL << deepest))
+    y = (1UL << deepest) - 1;
+
+  speed_count = fix->speed != GPS_INVALID_SPEED;
+  speed = speed_count ? fix->speed : 0;
+
+  for (level = 0; level < GPS_TILES_LEVELS; ++level)
+  {
+    byte shift = deepest - gps_tiles_zoom[level];
+    gps_tile_cell *cell = find_cell(tiles, level, x >> shift, y >> shift);
+    if (cell)
+      add_to_cell(cell, 1, speed_count, speed, speed);
+    else
+      ++tiles->_dropped;
+  }
+}
+
+void gps_tiles_merge(gps_tiles *dst, const gps_tiles *src)
+{
+  int level, i;
+
+  for (level = 0; level < GPS_TILES_LEVELS; ++level)
+    for (i = 0; i < GPS_TILES_CELLS; ++i)
+    {
+      const gps_tile_cell *from = &src->_cells[level][i];
+      if (from->count == 0)
+        continue;
+      gps_tile_cell *cell = find_cell(dst, level, from->x, from->y);
+      if (cell)
+        add_to_cell(cell, from->count, from->speed_count, from->speed_sum, from->speed_max);
+      else
+        dst->_dropped += from->count;
+    }
+  dst->_dropped += src->_dropped;
+}
+
+void gps_tiles_reset(gps_tiles *tiles)
+{
+  gps_tiles_init(tiles);
+}
+
+unsigned long gps_tiles_dropped(const gps_tiles *tiles)
+{
+  return tiles->_dropped;
+}
+
+size_t gps_tiles_export_size(const gps_tiles *tiles)
+{
+  size_t cells = 0;
+  int level;
+
+  for (level = 0; level < GPS_TILES_LEVELS; ++level)
+    cells += tiles->_used[level];
+  return cells * GPS_TILES_RECORD_SIZE;
+}
+
+static byte *put_le(byte *p, unsigned long v, int bytes)
+{
+  while (bytes--)
+  {
+    *p++ = (byte)v;
+    v >>= 8;
+  }
+  return p;
+}
+
+size_t gps_tiles_export(const gps_tiles *tiles, byte *buf, size_t len)
+{
+  byte *p = buf;
+  int level, i;
+
+  for (level = 0; level < GPS_TILES_LEVELS; ++level)
+    for (i = 0; i < GPS_TILES_CELLS; ++i)
+    {
+      const gps_tile_cell *cell = &tiles->_cells[level][i];
+      unsigned long mean = 0xFFFF, max = 0xFFFF;
+
+      if (cell->count == 0)
+        continue;
+      if ((size_t)(p - buf) + GPS_TILES_RECORD_SIZE > len)
+        return p - buf;
+
+      if (cell->speed_count)
+      {
+        mean = cell->speed_sum / cell->speed_count;
+        max = cell->speed_max;
+        if (mean > 0xFFFE)
+          mean = 0xFFFF;
+        if (max > 0xFFFE)
+          max = 0xFFFF;
+      }
+      p = put_le(p, gps_tiles_zoom[level], 1);
+      p = put_le(p, cell->x, 4);
+      p = put_le(p, cell->y, 4);
+      p = put_le(p, cell->count, 4);
+      p = put_le(p, mean, 2);
+      p = put_le(p, max, 2);
+    }
+  return p - buf;
+}
@@ -0,0 +1,71 @@
+/*
+gps_tiles - streaming density/speed aggregation of fixes into z/x/y map
+tiles (the Web Mercator "slippy map" scheme) at several zoom levels.
+
+Each fix costs one Mercator projection plus O(GPS_TILES_LEVELS) table
+updates: the tile at the deepest level is computed once and the coarser
+tiles are derived by shifting. Cells live in fixed open-addressed tables,
+one per level; fixes landing in a full table are counted as dropped.
+
+The tables hold a window, not a lifetime: export a snapshot and reset
+periodically. Each level takes GPS_TILES_CELLS * 3 / 4 = 96 tiles. A zoom
+16 tile is 611 m across at the equator and shrinks with the cosine of the
+latitude. In 5 minutes at 150 km/h a vehicle covers 12.5 km, which crosses
+at most 60 zoom 16 tiles anywhere up to 60 degrees latitude, so 5 minute
+windows do not drop.
+*/
+
+#ifndef gps_tiles_h
+#define gps_tiles_h
+
+#include <stddef.h>
+#include "tinygps.h"
+
+#define GPS_TILES_LEVELS 3
+#ifndef GPS_TILES_CELLS
+#define GPS_TILES_CELLS 128          // cells per level, power of two
+#endif
+#define GPS_TILES_RECORD_SIZE 17
+
+  // zoom of each level, coarsest first; the last entry is the deepest
+  extern const byte gps_tiles_zoom[GPS_TILES_LEVELS];
+
+  typedef struct gps_tile_cell {
+    unsigned long x, y;
+    unsigned long count;             // fixes binned, 0 marks an empty slot
+    unsigned long speed_count;       // fixes that carried a valid speed
+    unsigned long speed_sum;         // 100ths of a knot
+    unsigned long speed_max;
+  } gps_tile_cell;
+
+  typedef struct gps_tiles {
+    gps_tile_cell _cells[GPS_TILES_LEVELS][GPS_TILES_CELLS];
+    unsigned short _used[GPS_TILES_LEVELS];
+    unsigned long _dropped;
+  } gps_tiles;
+
+  void gps_tiles_init(gps_tiles *tiles);
+
+  // bin one committed fix; fixes without a valid position are ignored
+  void gps_tiles_add(gps_tiles *tiles, const gps_fix *fix);
+
+  // fold src into dst, e.g. per-thread aggregators into a shared one
+  void gps_tiles_merge(gps_tiles *dst, const gps_tiles *src);
+
+  // start a new window: forget every cell and the dropped count
+  void gps_tiles_reset(gps_tiles *tiles);
+
+  // fixes (counted once per level) that found their level's table full
+  unsigned long gps_tiles_dropped(const gps_tiles *tiles);
+
+  // bytes gps_tiles_export() needs for every cell
+  size_t gps_tiles_export_size(const gps_tiles *tiles);
+
+  // Write a snapshot into buf as a sequence of little-endian records
+  //   u8 z, u32 x, u32 y, u32 count, u16 mean speed, u16 max speed
+  // (speeds in 100ths of a knot, 0xFFFF when unknown or out of range).
+  // Returns the number of bytes written; cells that do not fit are skipped,
+  // so size buf with gps_tiles_export_size() before resetting
+  size_t gps_tiles_export(const gps_tiles *tiles, byte *buf, size_t len);
+
+#endif
@@ -0,0 +1,234 @@
+/*
+gps_trips - streaming stop/dwell detection and trip segmentation.
+See gps_trips.h.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "gps_trips.h"
+
+const gps_trips_config gps_trips_defaults = {
+  .radius_m = 50,
+  .dwell_ms = 3 * 60 * 1000,
+  .gap_ms = 5 * 60 * 1000,
+  .exit_fixes = 3
+};
+
+void gps_trips_init(gps_trips *t, const gps_trips_config *config)
+{
+  memset(t, 0, sizeof(*t));
+  t->_config = config ? *config : gps_trips_defaults;
+  if (t->_config.exit_fixes == 0)
+    t->_config.exit_fixes = 1;
+}
+
+static float distance_m(const gps_trips *t, long lat1, long lon1, long lat2, long lon2)
+{
+  float x, y;
+
+  x = (float)gps_delta_longitude(lon1, lon2) * t->_m_per_lon;
+  y = (float)(lat2 - lat1) * t->_m_per_lat;
+  return sqrtf(x * x + y * y);
+}
+
+static void centroid(const gps_trips *t, long *lat, long *lon)
+{
+  int64_t n = (int64_t)t->_count, half = n / 2;
+  *lat = t->_anchor_lat + (long)((t->_sum_lat + (t->_sum_lat < 0 ? -half : half)) / n);
+  // back into [-180, 180] degrees for a cluster on the antimeridian
+  *lon = (long)gps_delta_longitude(0,
+    t->_anchor_lon + (long)((t->_sum_lon + (t->_sum_lon < 0 ? -half : half)) / n));
+}
+
+static void start_cluster(gps_trips *t, int64_t time_ms, long lat, long lon)
+{
+  t->_have_cluster = true;
+  t->_stopped = false;
+  t->_anchor_lat = lat;
+  t->_anchor_lon = lon;
+  t->_m_per_lat = GPS_METERS_PER_LAT_UNIT;
+  t->_m_per_lon = GPS_METERS_PER_LAT_UNIT * cosf((float)lat / GPS_ANGLE_SCALE * (float)(PI / 180));
+  t->_sum_lat = 0;
+  t->_sum_lon = 0;
+  t->_count = 1;
+  t->_cluster_start = time_ms;
+  t->_cluster_last = time_ms;
+  t->_outside = 0;
+  t->_distance_at_cluster = t->_trip_distance;
+}
+
+static void join_cluster(gps_trips *t, int64_t time_ms, long lat, long lon)
+{
+  t->_sum_lat += lat - t->_anchor_lat;
+  t->_sum_lon += gps_delta_longitude(t->_anchor_lon, lon);
+  t->_count++;
+  t->_cluster_last = time_ms;
+  t->_outside = 0;
+}
+
+static void emit(gps_trip_sink sink, void *ctx, byte type, byte reason, int64_t time_ms,
+  int64_t start_ms, long lat, long lon, unsigned long fixes, float distance)
+{
+  gps_trip_event event;
+
+  event.type = type;
+  event.reason = reason;
+  event.time_ms = time_ms;
+  event.start_ms = start_ms;
+  event.latitude = lat;
+  event.longitude = lon;
+  event.fixes = fixes;
+  event.distance_m = distance;
+  sink(ctx, &event);
+}
+
+static void begin_trip(gps_trips *t, byte reason, int64_t time_ms, long lat, long lon,
+  gps_trip_sink sink, void *ctx)
+{
+  t->_in_trip = true;
+  t->_trip_start = time_ms;
+  t->_trip_distance = 0;
+  emit(sink, ctx, GPS_TRIP_START, reason, time_ms, time_ms, lat, lon, 0, 0);
+}
+
+static void end_trip(gps_trips *t, byte reason, int64_t time_ms, long lat, long lon, float distance,
+  gps_trip_sink sink, void *ctx)
+{
+  t->_in_trip = false;
+  emit(sink, ctx, GPS_TRIP_END, reason, time_ms, t->_trip_start, lat, lon, 0, distance);
+}
+
+// the stop is over as of time_ms
+static void end_dwell(gps_trips *t, byte reason, int64_t time_ms, gps_trip_sink sink, void *ctx)
+{
+  long lat, lon;
+
+  centroid(t, &lat, &lon);
+  emit(sink, ctx, GPS_TRIP_DWELL, reason, time_ms, t->_cluster_start, lat, lon, t->_count, 0);
+  t->_stopped = false;
+}
+
+void gps_trips_add(gps_trips *t, int64_t time_ms, long lat, long lon, gps_trip_sink sink, void *ctx)
+{
+  long clat, clon;
+  bool gap;
+
+  if (t->_have_last && time_ms <= t->_last_time)
+    return;
+  gap = t->_have_last && (uint64_t)(time_ms - t->_last_time) > t->_config.gap_ms;
+
+  if (gap)
+  {
+    if (t->_in_trip)
+      end_trip(t, GPS_TRIP_GAP, t->_last_time, t->_last_lat, t->_last_lon, t->_trip_distance, sink, ctx);
+    if (t->_stopped)
+    {
+      // back where it stopped: the dwell simply goes on
+      centroid(t, &clat, &clon);
+      if (distance_m(t, clat, clon, lat, lon) > t->_config.radius_m)
+      {
+        end_dwell(t, GPS_TRIP_GAP, t->_cluster_last, sink, ctx);
+        t->_have_cluster = false;
+      }
+    }
+    else
+    {
+      t->_have_cluster = false;
+    }
+  }
+  else if (t->_in_trip && t->_have_cluster)
+  {
+    t->_trip_distance += distance_m(t, t->_last_lat, t->_last_lon, lat, lon);
+  }
+
+  t->_have_last = true;
+  t->_last_time = time_ms;
+  t->_last_lat = lat;
+  t->_last_lon = lon;
+
+  if (!t->_have_cluster)
+  {
+    start_cluster(t, time_ms, lat, lon);
+    return;
+  }
+
+  centroid(t, &clat, &clon);
+  if (distance_m(t, clat, clon, lat, lon) <= t->_config.radius_m)
+  {
+    join_cluster(t, time_ms, lat, lon);
+    if (!t->_stopped && (uint64_t)(t->_cluster_last - t->_cluster_start) >= t->_config.dwell_ms)
+    {
+      t->_stopped = true;
+      if (t->_in_trip)
+      {
+        centroid(t, &clat, &clon);
+        end_trip(t, GPS_TRIP_STOPPED, t->_cluster_start, clat, clon, t->_distance_at_cluster, sink, ctx);
+      }
+    }
+    return;
+  }
+
+  if (t->_stopped)
+  {
+    if (++t->_outside < t->_config.exit_fixes)
+      return;
+    end_dwell(t, GPS_TRIP_MOVED, t->_cluster_last, sink, ctx);
+  }
+  if (!t->_in_trip)
+  {
+    begin_trip(t, GPS_TRIP_MOVED, t->_cluster_last, clat, clon, sink, ctx);
+    t->_trip_distance = distance_m(t, clat, clon, lat, lon);
+  }
+  start_cluster(t, time_ms, lat, lon);
+}
+
+void gps_trips_add_fix(gps_trips *t, const gps_fix *fix, gps_trip_sink sink, void *ctx)
+{
+  int64_t ms;
+
+  if (fix->latitude == GPS_INVALID_ANGLE || !gps_fix_time_ms(fix, &ms))
+    return;
+  gps_trips_add(t, ms, fix->latitude, fix->longitude, sink, ctx);
+}
+
+void gps_trips_ignition(gps_trips *t, bool on, int64_t time_ms, gps_trip_sink sink, void *ctx)
+{
+  long lat, lon;
+
+  if (!t->_have_last)
+    return;
+  if (!on)
+  {
+    if (t->_in_trip)
+      end_trip(t, GPS_TRIP_IGNITION, time_ms, t->_last_lat, t->_last_lon, t->_trip_distance, sink, ctx);
+    if (!t->_stopped)
+    {
+      // parked: a stop from now at the last position
+      start_cluster(t, time_ms, t->_last_lat, t->_last_lon);
+      t->_stopped = true;
+    }
+    return;
+  }
+
+  if (t->_in_trip)
+    return;
+  lat = t->_last_lat;
+  lon = t->_last_lon;
+  if (t->_stopped)
+  {
+    centroid(t, &lat, &lon);
+    end_dwell(t, GPS_TRIP_IGNITION, time_ms, sink, ctx);
+  }
+  begin_trip(t, GPS_TRIP_IGNITION, time_ms, lat, lon, sink, ctx);
+  start_cluster(t, time_ms, t->_last_lat, t->_last_lon);
+}
+
+void gps_trips_finish(gps_trips *t, gps_trip_sink sink, void *ctx)
+{
+  if (t->_in_trip)
+    end_trip(t, GPS_TRIP_GAP, t->_last_time, t->_last_lat, t->_last_lon, t->_trip_distance, sink, ctx);
+  if (t->_stopped)
+    end_dwell(t, GPS_TRIP_GAP, t->_cluster_last, sink, ctx);
+  t->_have_cluster = false;
+  t->_have_last = false;
+}
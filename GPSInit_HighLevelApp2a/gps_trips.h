@@ -0,0 +1,106 @@
+/*
+gps_trips - streaming stop/dwell detection and trip segmentation over
+committed fixes.
+
+Fixes are clustered on the fly: a cluster is its anchor, a running
+centroid and a time span, so memory is constant however long the device
+stays put. A fix within radius_m of the centroid joins the cluster; once
+the cluster has lasted dwell_ms it is a stop. A stop ends when exit_fixes
+fixes in a row fall outside it, so a single multipath jump does not split
+a dwell. Trips are the stretches between stops, long gaps in the fixes
+and ignition off/on.
+
+Events, in stream order:
+  GPS_TRIP_START  leaving a stop (or the first movement seen, or ignition
+                  on); position is where the trip started
+  GPS_TRIP_END    a stop was confirmed, the fixes stopped for gap_ms or the
+                  ignition went off; time is the arrival, position the stop
+                  centroid (or the last fix for gaps)
+  GPS_TRIP_DWELL  a stop ended; start_ms to time_ms at the centroid
+TRIP_END for a stop is reported dwell_ms after arrival, as soon as it is
+known, rather than when the device moves again.
+
+Distances are local flat-earth metres from integer 10^-7 degree offsets,
+with the cosine of the latitude taken once per cluster.
+*/
+
+#ifndef gps_trips_h
+#define gps_trips_h
+
+#include <stdint.h>
+#include "tinygps.h"
+
+  enum {
+    GPS_TRIP_START,
+    GPS_TRIP_END,
+    GPS_TRIP_DWELL
+  };
+
+  // why a trip started or ended, or a dwell ended
+  enum {
+    GPS_TRIP_MOVED,                  // left a stop
+    GPS_TRIP_STOPPED,                // stayed within radius_m for dwell_ms
+    GPS_TRIP_GAP,                    // no fixes for gap_ms
+    GPS_TRIP_IGNITION
+  };
+
+  typedef struct gps_trip_event {
+    byte type;                       // GPS_TRIP_*
+    byte reason;
+    int64_t time_ms;                 // ms since 1970, see gps_fix_time_ms()
+    int64_t start_ms;                // trip end: when it started; dwell: arrival
+    long latitude, longitude;        // 10^-7 degree
+    unsigned long fixes;             // dwell: fixes in the stop
+    float distance_m;                // trip end: distance travelled
+  } gps_trip_event;
+
+  typedef void (*gps_trip_sink)(void *ctx, const gps_trip_event *event);
+
+  typedef struct gps_trips_config {
+    float radius_m;
+    unsigned long dwell_ms;
+    unsigned long gap_ms;
+    byte exit_fixes;
+  } gps_trips_config;
+
+  // 50 m, 3 minutes, 5 minutes, 3 fixes
+  extern const gps_trips_config gps_trips_defaults;
+
+  typedef struct gps_trips {
+    gps_trips_config _config;
+
+    // current cluster: candidate stop, or confirmed stop when _stopped
+    bool _have_cluster;
+    bool _stopped;
+    long _anchor_lat, _anchor_lon;
+    float _m_per_lat, _m_per_lon;    // metres per 10^-7 degree at the anchor
+    int64_t _sum_lat, _sum_lon;      // offsets from the anchor
+    unsigned long _count;
+    int64_t _cluster_start, _cluster_last;
+    byte _outside;                   // consecutive fixes outside a stop
+
+    bool _in_trip;
+    int64_t _trip_start;
+    float _trip_distance;
+    float _distance_at_cluster;      // trip distance when the cluster began
+
+    bool _have_last;
+    int64_t _last_time;
+    long _last_lat, _last_lon;
+  } gps_trips;
+
+  // config may be NULL for gps_trips_defaults
+  void gps_trips_init(gps_trips *t, const gps_trips_config *config);
+
+  // Feed fixes in time order. Fixes without a position or time are ignored,
+  // as are repeats of the last time (RMC and GGA of one epoch)
+  void gps_trips_add(gps_trips *t, int64_t time_ms, long lat, long lon, gps_trip_sink sink, void *ctx);
+  void gps_trips_add_fix(gps_trips *t, const gps_fix *fix, gps_trip_sink sink, void *ctx);
+
+  // ignition or any other "vehicle in use" signal
+  void gps_trips_ignition(gps_trips *t, bool on, int64_t time_ms, gps_trip_sink sink, void *ctx);
+
+  // end of data: close the open trip or dwell at the last fix
+  void gps_trips_finish(gps_trips *t, gps_trip_sink sink, void *ctx);
+
+#endif
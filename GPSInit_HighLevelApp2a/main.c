@@ -35,12 +35,34 @@
 // gps parser
 #include "tinygps.h"
 
+// startup milestones and time to first fix
+#include "boot_timeline.h"
+
+// per-subsystem memory accounting and stack high-water mark
+#include "mem_stats.h"
+#include "mem_pool.h"
+
+// lifetime counters kept across restarts
+#include "persistent_stats.h"
+
+// extended ephemeris aiding
+#include "ephemeris_loader.h"
+#include "uart_tx.h"
+#include "command_engine.h"
+
+// stop and trip detection
+#include "gps_trips.h"
+
 // File descriptors - initialized to invalid value
 static int gpsPwrGpioFd = -1;		//  AVNET_MT3620_SK_GPIO0 on Click Socket1 PWM to board PWR ON_OFF input line
 static int gpsWakeupGpioFd = -1;    //   AVNET_MT3620_SK_GPIO42 on Click Socket1 AN to board WAKEUP
 static int SampleBlueLedGpioFd = -1;    // On board BLUE LED  SAMPLE_RGBLED_BLUE
 static int uartFd = -1;				// UART ISU0 TX/RX on both sockets
 static int gpsInitTimerFd = -1;	
+static int memReportTimerFd = -1;
+static int statsFlushTimerFd = -1;
+static int ephemerisTimerFd = -1;
+static int commandTimerFd = -1;
 static int epollFd = -1;
 
 
@@ -50,6 +72,83 @@ static int epollFd = -1;
 // Using 500uSec
 static const struct timespec pulseInterval = {0, 500000};
 
+// Memory use is logged this often; the event loop stack is painted this deep
+static const struct timespec memReportInterval = {300, 0};
+static const size_t stackPaintDepth = 8 * 1024;
+
+// Persistent stats are checked for changes this often, but written to flash at most
+// every statsMinFlushSeconds
+static const struct timespec statsFlushInterval = {60, 0};
+static const unsigned int statsMinFlushSeconds = 15 * 60;
+
+// UART bit rate of the receiver, which the ephemeris transfer keeps when it switches
+// the receiver to its binary protocol and back
+static const uint32_t uartBaudRate = 4800;
+
+// Extended ephemeris shipped in the image package, which only seeds the copy in mutable
+// storage, and the oldest data worth sending. At 4800 baud the UART moves about
+// 480 bytes/s, so 64 bytes every 150 ms keeps it busy without overrunning it
+static const char ephemerisSeedPath[] = "ephemeris/sgee.bin";
+static const uint32_t ephemerisMaxAgeSeconds = 3 * 24 * 60 * 60;
+static const struct timespec ephemerisChunkInterval = {0, 150 * 1000 * 1000};
+static const size_t ephemerisChunkSize = 64;
+
+// Receiver configuration, sent once it is awake. The SiRF receiver does not acknowledge
+// PSRF103, so each rate change is confirmed by the output after it: RMC and GGA by
+// showing up, the sentences turned off by staying away for longer than their default
+// interval (GSV comes every 5 s). Only RMC and GGA are parsed; the other default
+// sentences just cost UART time.
+static const CommandStep receiverSetup[] = {
+	{.body = "PSRF103,02,00,00,01", .expect = "GPGSA", .timeoutMs = 2500, .retries = 2,
+	 .flags = CommandFlag_Absent},
+	{.body = "PSRF103,03,00,00,01", .expect = "GPGSV", .timeoutMs = 6000, .retries = 2,
+	 .flags = CommandFlag_Absent},
+	{.body = "PSRF103,05,00,00,01", .expect = "GPVTG", .timeoutMs = 2500, .retries = 2,
+	 .flags = CommandFlag_Absent},
+	{.body = "PSRF103,00,00,01,01", .expect = "GPGGA", .timeoutMs = 2500, .retries = 2},
+	{.body = "PSRF103,04,00,01,01", .expect = "GPRMC", .timeoutMs = 2500, .retries = 2},
+};
+static const struct timespec commandPollInterval = {0, 100 * 1000 * 1000};
+
+// Most memory each subsystem may reserve for its pools and arenas. The UART and index
+// arenas below are reserved against these at init and released at close
+static const size_t memBudgets[MemTag_Count] = {
+	[MemTag_Parser] = 4 * 1024,
+	[MemTag_Uart] = 4 * 1024,
+	[MemTag_Index] = 32 * 1024,
+	[MemTag_Other] = 16 * 1024,
+};
+
+// Upper bound on UART reads handled per epoll wakeup
+static const int uartMaxReadsPerEvent = 16;
+
+// Storage for the UART and index arenas
+static uint8_t uartArenaStorage[1024] __attribute__((aligned(8)));
+static uint8_t indexArenaStorage[sizeof(gps_trips)] __attribute__((aligned(8)));
+static MemArena uartArena;
+static MemArena indexArena;
+
+// Transmit queue for commands and aiding data sent to the receiver; its buffer
+// is the whole UART arena
+static UartTxQueue uartTx;
+
+// UART receive statistics
+static struct {
+	unsigned long events;		// epoll wakeups for the UART
+	unsigned long reads;		// successful read() calls
+	unsigned long bytes;		// total bytes received
+	size_t maxBytesPerEvent;	// largest backlog drained in one wakeup
+} uartStats;
+
+// Parser generation of the last position printed
+static unsigned int lastLoggedGeneration;
+
+// WAKEUP was high after the power pulse; extended ephemeris is only sent to an awake receiver
+static bool gpsAwake;
+
+// Stops and trips of the fixes committed so far, in the index arena
+static gps_trips *trips;
+
 // Termination state
 static volatile sig_atomic_t terminationRequired = false;
 
@@ -62,6 +161,65 @@ static void TerminationHandler(int signalNumber)
     terminationRequired = true;
 }
 
+/// <summary>
+///     Ephemeris timer: stream the next chunk of aiding data, stopping when done.
+/// </summary>
+static void EphemerisTimerEventHandler(EventData *eventData)
+{
+	if (ConsumeTimerFdEvent(ephemerisTimerFd) != 0) {
+		terminationRequired = true;
+		return;
+	}
+	if (!EphemerisLoader_Pump(ephemerisChunkSize)) {
+		UnregisterEventHandlerFromEpoll(epollFd, ephemerisTimerFd);
+		CloseFdAndPrintError(ephemerisTimerFd, "EphemerisTimer");
+		ephemerisTimerFd = -1;
+	}
+}
+
+static EventData ephemerisTimerEventData = {.eventHandler = &EphemerisTimerEventHandler};
+
+/// <summary>
+///     Hand the receiver extended ephemeris while it searches, if it is awake and we have
+///     fresh data. The transfer switches the receiver to its binary protocol, so it must
+///     have the UART to itself: call only once the command pipeline has ended.
+/// </summary>
+static void StartEphemeris(void)
+{
+	if (!gpsAwake || ephemerisTimerFd >= 0 ||
+		EphemerisLoader_Start(&uartTx, ephemerisMaxAgeSeconds, uartBaudRate) != 0) {
+		return;
+	}
+	ephemerisTimerFd = CreateTimerFdAndAddToEpoll(epollFd, &ephemerisChunkInterval,
+												  &ephemerisTimerEventData, EPOLLIN);
+	if (ephemerisTimerFd < 0) {
+		EphemerisLoader_Stop();
+	}
+}
+
+/// <summary>
+///     Command timer: time out and retry receiver commands until the setup pipeline ends,
+///     then start the ephemeris transfer, which needs the UART to itself.
+/// </summary>
+static void CommandTimerEventHandler(EventData *eventData)
+{
+	if (ConsumeTimerFdEvent(commandTimerFd) != 0) {
+		terminationRequired = true;
+		return;
+	}
+	if (!CommandEngine_Poll()) {
+		UnregisterEventHandlerFromEpoll(epollFd, commandTimerFd);
+		CloseFdAndPrintError(commandTimerFd, "CommandTimer");
+		commandTimerFd = -1;
+		if (CommandEngine_GetStatus().state == CommandState_Done) {
+			BootTimeline_Mark(BootPhase_Configured);
+		}
+		StartEphemeris();
+	}
+}
+
+static EventData commandTimerEventData = {.eventHandler = &CommandTimerEventHandler};
+
 /// <summary>
 ///     Handle Pulse PWR timer event - somehow.
 /// </summary>
@@ -93,7 +251,8 @@ static void gpsInitTimerEventHandler(EventData *eventData)
 		terminationRequired = true;
 		return;
 	}
-	if (gpsWakeupState == GPIO_Value_High) {
+	gpsAwake = gpsWakeupState == GPIO_Value_High;
+	if (gpsAwake) {
 		Log_Debug("GPS Awake\n");
 		// If GPS unit is already or now AWAKE turn on the Blue LED. For LEDs Low is active ON
 		result = GPIO_SetValue(SampleBlueLedGpioFd, GPIO_Value_Low);
@@ -104,46 +263,194 @@ static void gpsInitTimerEventHandler(EventData *eventData)
 		}
 	}
 
+	// Configure the receiver first; the command timer starts the ephemeris once the
+	// pipeline has ended, so the two never share the UART
+	if (commandTimerFd < 0) {
+		commandTimerFd = CreateTimerFdAndAddToEpoll(epollFd, &commandPollInterval,
+													&commandTimerEventData, EPOLLIN);
+		if (commandTimerFd >= 0) {
+			CommandEngine_Start(&uartTx, receiverSetup, sizeof(receiverSetup) / sizeof(receiverSetup[0]));
+		} else {
+			StartEphemeris();
+		}
+	}
+
 	Log_Debug("Now GPS data from UART\n");
 
 }
 
 /// <summary>
-///     Handle UART event: if there is incoming data, print it.
+///     Trip event sink: log trip starts and ends and the stops between them.
+/// </summary>
+static void TripEventHandler(void *context, const gps_trip_event *event)
+{
+	static const char *const types[] = {"Trip start", "Trip end", "Dwell"};
+	static const char *const reasons[] = {"moved", "stopped", "gap", "ignition"};
+	long latitude = event->latitude, longitude = event->longitude;
+
+	(void)context;
+	Log_Debug("%s (%s) at %s%ld.%07ld, %s%ld.%07ld after %lld s", types[event->type],
+			  reasons[event->reason],
+			  latitude < 0 ? "-" : "", labs(latitude) / GPS_ANGLE_SCALE, labs(latitude) % GPS_ANGLE_SCALE,
+			  longitude < 0 ? "-" : "", labs(longitude) / GPS_ANGLE_SCALE, labs(longitude) % GPS_ANGLE_SCALE,
+			  (long long)((event->time_ms - event->start_ms) / 1000));
+	if (event->type == GPS_TRIP_END) {
+		Log_Debug(", %ld m", (long)event->distance_m);
+	}
+	Log_Debug("\n");
+}
+
+/// <summary>
+///     Feeds received bytes to the parser a line at a time and passes every fix it commits
+///     to trip detection, so a burst holding several epochs does not skip any of them.
+/// </summary>
+/// <returns>Number of sentences committed</returns>
+static unsigned int EncodeAndTrack(const uint8_t *data, size_t length)
+{
+	unsigned int sentences = 0;
+
+	while (length != 0) {
+		const uint8_t *newline = memchr(data, '\n', length);
+		size_t lineLength = newline != NULL ? (size_t)(newline - data) + 1 : length;
+		unsigned int committed = gps_encode_buffer((const char *)data, (unsigned int)lineLength);
+		if (committed != 0) {
+			gps_fix fix;
+			gps_get_fix(&fix);
+			gps_trips_add_fix(trips, &fix, TripEventHandler, NULL);
+			sentences += committed;
+		}
+		data += lineLength;
+		length -= lineLength;
+	}
+	return sentences;
+}
+
+/// <summary>
+///     Handle UART event: send queued output when the UART can take it, drain whatever
+///     the UART has buffered, feed it to the parser and trip detection and, when a new fix
+///     has been committed, print the position.
 /// </summary>
 static void UartEventHandler(EventData* eventData)
 {
 	const size_t receiveBufferSize = 256;
 	uint8_t receiveBuffer[receiveBufferSize + 1]; // allow extra byte for string termination
 	ssize_t bytesRead;
+	size_t bytesThisEvent = 0;
+	int readsThisEvent = 0;
+	unsigned int sentences = 0;
 
-	// Read incoming UART data. It is expected behavior that messages may be received in multiple
-	// partial chunks.
-	bytesRead = read(uartFd, receiveBuffer, receiveBufferSize);
-	if (bytesRead < 0) {
-		Log_Debug("ERROR: Could not read UART: %s (%d).\n", strerror(errno), errno);
+	if ((eventData->events & EPOLLOUT) && UartTx_OnWritable(&uartTx) != 0) {
 		terminationRequired = true;
 		return;
 	}
+	if (!(eventData->events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+		return;
+	}
+
+	// Read incoming UART data. It is expected behavior that messages may be received in multiple
+	// partial chunks. After a burst (e.g. the receiver flushing its output at power up) there can
+	// be several buffers queued, so keep reading until the UART is empty rather than taking one
+	// epoll round trip per buffer. The read count is capped so a continuous stream cannot starve
+	// the other handlers; epoll is level triggered and will call us again for the remainder.
+	while (readsThisEvent < uartMaxReadsPerEvent) {
+		bytesRead = read(uartFd, receiveBuffer, receiveBufferSize);
+		if (bytesRead < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			Log_Debug("ERROR: Could not read UART: %s (%d).\n", strerror(errno), errno);
+			terminationRequired = true;
+			return;
+		}
+		if (bytesRead == 0) {
+			break;
+		}
+
+		BootTimeline_Mark(BootPhase_FirstByte);
+		++readsThisEvent;
+		bytesThisEvent += (size_t)bytesRead;
+		PersistentStats_AddUartBytes((uint32_t)bytesRead);
+		CommandEngine_Feed(receiveBuffer, (size_t)bytesRead);
+		sentences += EncodeAndTrack(receiveBuffer, (size_t)bytesRead);
 
-	if (bytesRead > 0) {
-		for (int i = 0; i < bytesRead; i++) {
-			gps_encode(receiveBuffer[i]);
+		if ((size_t)bytesRead < receiveBufferSize) {
+			break;
 		}
 	}
 
-	float latitude, longitude;
+	PersistentStats_SampleParser();
+
+	// Track how deep the UART backlog gets so bursts are visible in the log
+	++uartStats.events;
+	uartStats.reads += (unsigned long)readsThisEvent;
+	uartStats.bytes += bytesThisEvent;
+	if (bytesThisEvent > uartStats.maxBytesPerEvent) {
+		uartStats.maxBytesPerEvent = bytesThisEvent;
+		Log_Debug("UART backlog peak: %zu bytes in %d reads (%u sentences)\n", bytesThisEvent,
+				  readsThisEvent, sentences);
+	}
+
+	// Nothing to report until the parser commits another fix
+	unsigned int generation = gps_generation();
+	if (generation == lastLoggedGeneration) {
+		return;
+	}
+	lastLoggedGeneration = generation;
+
+	if (!BootTimeline_IsMarked(BootPhase_FirstFix)) {
+		BootTimeline_Mark(BootPhase_FirstFix);
+		BootTimeline_Report();
+		PersistentStats_RecordTtff((uint32_t)BootTimeline_ElapsedMs(BootPhase_FirstFix));
+		EphemerisStatus ephemeris = EphemerisLoader_GetStatus();
+		Log_Debug("TTFF %ld ms, extended ephemeris %s (%lu of %lu bytes)\n",
+				  BootTimeline_ElapsedMs(BootPhase_FirstFix),
+				  ephemeris.state == EphemerisState_Done ? "sent" : "not sent",
+				  (unsigned long)ephemeris.bytesSent, (unsigned long)ephemeris.payloadLength);
+	}
+
+	long latitude, longitude;
 	unsigned long fix_age;
-	gps_f_get_position(&latitude, &longitude, &fix_age);
-	Log_Debug("Position: %f, %f; fix age: %f\n\r", latitude, longitude, fix_age);
+	gps_get_position_e7(&latitude, &longitude, &fix_age);
+	Log_Debug("Position: %s%ld.%07ld, %s%ld.%07ld; fix age: %lu\n\r",
+			  latitude < 0 ? "-" : "", labs(latitude) / GPS_ANGLE_SCALE, labs(latitude) % GPS_ANGLE_SCALE,
+			  longitude < 0 ? "-" : "", labs(longitude) / GPS_ANGLE_SCALE, labs(longitude) % GPS_ANGLE_SCALE,
+			  fix_age);
+}
+
+/// <summary>
+///     Memory report timer: log per-subsystem use and the stack high-water mark.
+/// </summary>
+static void MemReportTimerEventHandler(EventData *eventData)
+{
+	if (ConsumeTimerFdEvent(memReportTimerFd) != 0) {
+		terminationRequired = true;
+		return;
+	}
+	MemStats_Report();
+}
+
+/// <summary>
+///     Stats flush timer: checkpoint the lifetime counters if they are due.
+/// </summary>
+static void StatsFlushTimerEventHandler(EventData *eventData)
+{
+	if (ConsumeTimerFdEvent(statsFlushTimerFd) != 0) {
+		terminationRequired = true;
+		return;
+	}
+	PersistentStats_Flush(false);
 }
 
 // event handler data structures. Only the event handler field needs to be populated.
 static EventData gpsInitTimerEventData = {.eventHandler = &gpsInitTimerEventHandler};
 static EventData uartEventData = { .eventHandler = &UartEventHandler };
+static EventData memReportTimerEventData = { .eventHandler = &MemReportTimerEventHandler };
+static EventData statsFlushTimerEventData = { .eventHandler = &StatsFlushTimerEventHandler };
 
 /// <summary>
 ///     Set up SIGTERM termination handler, initialize peripherals, and set up event handlers.
+///     The UART is opened before the receiver is powered so nothing it sends while
+///     waking up is lost; each step is recorded on the boot timeline.
 /// </summary>
 /// <returns>0 on success, or -1 on failure</returns>
 static int InitPeripheralsAndHandlers(void)
@@ -153,10 +460,15 @@ static int InitPeripheralsAndHandlers(void)
 	action.sa_handler = TerminationHandler;
 	sigaction(SIGTERM, &action, NULL);
 
+	for (int i = 0; i < MemTag_Count; i++) {
+		MemStats_SetBudget((MemTag)i, memBudgets[i]);
+	}
+
 	epollFd = CreateEpollFd();
 	if (epollFd < 0) {
 		return -1;
 	}
+	BootTimeline_Mark(BootPhase_Epoll);
 
 
 	// Open PWR GPIO, set as output with value GPIO_Value_Low (off)
@@ -169,8 +481,8 @@ static int InitPeripheralsAndHandlers(void)
 
 	Log_Debug("Opening GPS WAKEUP as input.\n");
 	gpsWakeupGpioFd = GPIO_OpenAsInput(AVNET_MT3620_SK_GPIO42);	// input from GPS WAKEUP pad
-	if (gpsPwrGpioFd < 0) {
-		Log_Debug("ERROR: Could not open GPS WAKUP GPIO: %s (%d).\n,strerror(errno), errno");
+	if (gpsWakeupGpioFd < 0) {
+		Log_Debug("ERROR: Could not open GPS WAKUP GPIO: %s (%d).\n", strerror(errno), errno);
 		return -1;
 	}
 
@@ -182,6 +494,35 @@ static int InitPeripheralsAndHandlers(void)
 		terminationRequired = true;
 		return -1;
 	}
+	BootTimeline_Mark(BootPhase_Gpio);
+
+
+	// Create a UART_Config object, open the UART and set up UART event handler.
+	// Done before the power pulse so the UART is already buffering when the receiver
+	// starts talking, instead of dropping its first sentences.
+	UART_Config uartConfig;
+	UART_InitConfig(&uartConfig);
+	uartConfig.baudRate = uartBaudRate;
+	uartConfig.flowControl = UART_FlowControl_None;
+	uartFd = UART_Open(SAMPLE_UART, &uartConfig);
+	if (uartFd < 0) {
+		Log_Debug("ERROR: Could not open UART: %s (%d).\n", strerror(errno), errno);
+		return -1;
+	}
+	if (RegisterEventHandlerToEpoll(epollFd, uartFd, &uartEventData, EPOLLIN) != 0) {
+	return -1;
+	}
+	uint8_t *uartTxBuffer = NULL;
+	if (MemArena_Init(&uartArena, MemTag_Uart, uartArenaStorage, sizeof(uartArenaStorage)) == 0) {
+		uartTxBuffer = MemArena_Alloc(&uartArena, sizeof(uartArenaStorage));
+	}
+	if (uartTxBuffer == NULL) {
+		Log_Debug("ERROR: UART buffers exceed the UART memory budget.\n");
+		return -1;
+	}
+	UartTx_Init(&uartTx, uartFd, epollFd, &uartEventData, EPOLLIN, uartTxBuffer, sizeof(uartArenaStorage));
+	BootTimeline_Mark(BootPhase_Uart);
+
 
 	// Now check WAKEUP and only send a pulse if OFF
 	GPIO_Value_Type gpsWakeupState;
@@ -209,23 +550,39 @@ static int InitPeripheralsAndHandlers(void)
 	if (gpsInitTimerFd < 0) {
 		return -1;
 	}
+	BootTimeline_Mark(BootPhase_PowerPulse);
 
-
-	// Create a UART_Config object, open the UART and set up UART event handler
-	UART_Config uartConfig;
-	UART_InitConfig(&uartConfig);
-	uartConfig.baudRate = 4800;
-	uartConfig.flowControl = UART_FlowControl_None;
-	uartFd = UART_Open(SAMPLE_UART, &uartConfig);
-	if (uartFd < 0) {
-		Log_Debug("ERROR: Could not open UART: %s (%d).\n", strerror(errno), errno);
+	memReportTimerFd = CreateTimerFdAndAddToEpoll(epollFd, &memReportInterval,
+												  &memReportTimerEventData, EPOLLIN);
+	if (memReportTimerFd < 0) {
 		return -1;
 	}
-	if (RegisterEventHandlerToEpoll(epollFd, uartFd, &uartEventData, EPOLLIN) != 0) {
-	return -1;
+	MemStats_Add(MemTag_Parser, sizeof(gps_parser));
+	if (MemArena_Init(&indexArena, MemTag_Index, indexArenaStorage, sizeof(indexArenaStorage)) == 0) {
+		trips = MemArena_Alloc(&indexArena, sizeof(gps_trips));
+	}
+	if (trips == NULL) {
+		Log_Debug("ERROR: Trip detection exceeds the index memory budget.\n");
+		return -1;
 	}
+	gps_trips_init(trips, NULL);
+
+	// Lifetime counters are useful but not essential; run without them if storage fails
+	if (PersistentStats_Open(statsMinFlushSeconds) == 0) {
+		PersistentStats_Report();
+		statsFlushTimerFd = CreateTimerFdAndAddToEpoll(epollFd, &statsFlushInterval,
+													   &statsFlushTimerEventData, EPOLLIN);
+		if (statsFlushTimerFd < 0) {
+			return -1;
+		}
+	}
+
+	// Seed the stored ephemeris on first boot or after a redeploy with newer data; a
+	// downloader refreshes it the same way between deployments
+	EphemerisLoader_Refresh(NULL, ephemerisSeedPath);
 
 	// everything worked, return zero status
+	BootTimeline_Mark(BootPhase_InitDone);
 	return 0;
 }
 
@@ -241,6 +598,17 @@ static void ClosePeripheralsAndHandlers(void)
 
     Log_Debug("Closing file descriptors.\n");
     CloseFdAndPrintError(gpsInitTimerFd, "BlinkingLedTimer");
+    CloseFdAndPrintError(memReportTimerFd, "MemReportTimer");
+    CloseFdAndPrintError(statsFlushTimerFd, "StatsFlushTimer");
+    EphemerisLoader_Stop();
+    CloseFdAndPrintError(ephemerisTimerFd, "EphemerisTimer");
+    CommandEngine_Stop();
+    CloseFdAndPrintError(commandTimerFd, "CommandTimer");
+    PersistentStats_Close();
+    CloseFdAndPrintError(uartFd, "Uart");
+    MemArena_Deinit(&uartArena);
+    trips = NULL;
+    MemArena_Deinit(&indexArena);
     CloseFdAndPrintError(gpsPwrGpioFd, "BlinkingLedGpio");
     CloseFdAndPrintError(epollFd, "Epoll");
 }
@@ -250,6 +618,8 @@ static void ClosePeripheralsAndHandlers(void)
 /// </summary>
 int main(int argc, char *argv[])
 {
+    BootTimeline_Start();
+    MemStats_PaintStack(stackPaintDepth);
     Log_Debug("GPS Init application starting.\n");
     if (InitPeripheralsAndHandlers() != 0) {
         terminationRequired = true;
@@ -262,6 +632,7 @@ int main(int argc, char *argv[])
         }
     }
 
+    MemStats_Report();
     ClosePeripheralsAndHandlers();
     Log_Debug("Application exiting.\n");
     return 0;
@@ -0,0 +1,119 @@
+/* Licensed under the MIT License. */
+
+#include <stdint.h>
+#include "mem_pool.h"
+
+// Alignment suitable for any scalar type on the target
+#define MEM_ALIGN (sizeof(long long) > sizeof(void *) ? sizeof(long long) : sizeof(void *))
+
+static size_t AlignUp(size_t n)
+{
+    return (n + MEM_ALIGN - 1) & ~(MEM_ALIGN - 1);
+}
+
+size_t MemPool_BlockStride(size_t blockSize)
+{
+    return AlignUp(blockSize < sizeof(void *) ? sizeof(void *) : blockSize);
+}
+
+int MemPool_Init(MemPool *pool, MemTag tag, void *storage, size_t blockSize, size_t blockCount)
+{
+    size_t stride = MemPool_BlockStride(blockSize);
+
+    pool->freeList = NULL;
+    pool->blockSize = blockSize;
+    pool->blockCount = 0;
+    pool->blocksInUse = 0;
+    pool->tag = tag;
+
+    if (!MemStats_Reserve(tag, stride * blockCount)) {
+        return -1;
+    }
+
+    // Thread the free list through the blocks, first block at the head
+    unsigned char *block = (unsigned char *)storage + stride * blockCount;
+    for (size_t i = 0; i < blockCount; i++) {
+        block -= stride;
+        *(void **)block = pool->freeList;
+        pool->freeList = block;
+    }
+    pool->blockCount = blockCount;
+    return 0;
+}
+
+void MemPool_Deinit(MemPool *pool)
+{
+    MemStats_Release(pool->tag, MemPool_BlockStride(pool->blockSize) * pool->blockCount);
+    pool->freeList = NULL;
+    pool->blockCount = 0;
+    pool->blocksInUse = 0;
+}
+
+void *MemPool_Alloc(MemPool *pool)
+{
+    void *block = pool->freeList;
+    if (block == NULL) {
+        MemStats_NoteExhausted(pool->tag);
+        return NULL;
+    }
+    pool->freeList = *(void **)block;
+    pool->blocksInUse++;
+    return block;
+}
+
+void MemPool_Free(MemPool *pool, void *block)
+{
+    if (block == NULL) {
+        return;
+    }
+    *(void **)block = pool->freeList;
+    pool->freeList = block;
+    pool->blocksInUse--;
+}
+
+int MemArena_Init(MemArena *arena, MemTag tag, void *storage, size_t size)
+{
+    arena->base = storage;
+    arena->size = 0;
+    arena->used = 0;
+    arena->tag = tag;
+
+    if (!MemStats_Reserve(tag, size)) {
+        return -1;
+    }
+    arena->size = size;
+    return 0;
+}
+
+void MemArena_Deinit(MemArena *arena)
+{
+    MemStats_Release(arena->tag, arena->size);
+    arena->size = 0;
+    arena->used = 0;
+}
+
+void *MemArena_Alloc(MemArena *arena, size_t bytes)
+{
+    // Align the returned address, not just the offset, as storage may be unaligned
+    uintptr_t start = ((uintptr_t)arena->base + arena->used + MEM_ALIGN - 1) & ~(uintptr_t)(MEM_ALIGN - 1);
+    size_t offset = start - (uintptr_t)arena->base;
+
+    if (offset > arena->size || bytes > arena->size - offset) {
+        MemStats_NoteExhausted(arena->tag);
+        return NULL;
+    }
+    arena->used = offset + bytes;
+    return arena->base + offset;
+}
+
+MemArenaMark MemArena_Mark(const MemArena *arena)
+{
+    return arena->used;
+}
+
+void MemArena_Reset(MemArena *arena, MemArenaMark mark)
+{
+    if (mark < arena->used) {
+        arena->used = mark;
+    }
+}
@@ -0,0 +1,96 @@
+/* Licensed under the MIT License. */
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include "mem_stats.h"
+
+/// <summary>
+/// <para>Fixed-block pool carved out of caller-provided storage.</para>
+/// <para>Alloc and Free are O(1) pushes/pops on an intrusive free list; nothing is
+/// ever returned to or taken from the system heap after init.</para>
+/// </summary>
+typedef struct MemPool {
+    void *freeList;
+    size_t blockSize;
+    size_t blockCount;
+    size_t blocksInUse;
+    MemTag tag;
+} MemPool;
+
+/// <summary>
+/// <para>Bump arena carved out of caller-provided storage.</para>
+/// <para>Allocations are O(1) and are released together by resetting the arena to a
+/// mark taken earlier, e.g. per sentence or per report.</para>
+/// </summary>
+typedef struct MemArena {
+    unsigned char *base;
+    size_t size;
+    size_t used;
+    MemTag tag;
+} MemArena;
+
+/// <summary>
+///     Opaque position in an arena, see MemArena_Mark.
+/// </summary>
+typedef size_t MemArenaMark;
+
+/// <summary>
+///     Initializes a pool of blockCount blocks of blockSize bytes over storage, which
+///     must hold blockCount * MemPool_BlockStride(blockSize) bytes, be aligned for any
+///     scalar type and stay valid for the life of the pool. The storage is charged
+///     against the tag's budget.
+/// </summary>
+/// <returns>0 on success, or -1 if the tag's budget does not allow it</returns>
+int MemPool_Init(MemPool *pool, MemTag tag, void *storage, size_t blockSize, size_t blockCount);
+
+/// <summary>
+///     Returns the pool's storage to its tag's budget. Every block must have been freed;
+///     the pool is empty afterwards and may be initialized again.
+/// </summary>
+void MemPool_Deinit(MemPool *pool);
+
+/// <summary>
+///     Bytes each block occupies in pool storage: blockSize rounded up so every block
+///     can hold a free-list link and is suitably aligned.
+/// </summary>
+size_t MemPool_BlockStride(size_t blockSize);
+
+/// <summary>
+///     Takes a block from the pool.
+/// </summary>
+/// <returns>The block, or NULL if the pool is exhausted (counted in the memory report)</returns>
+void *MemPool_Alloc(MemPool *pool);
+
+/// <summary>
+///     Returns a block obtained from MemPool_Alloc on the same pool.
+/// </summary>
+void MemPool_Free(MemPool *pool, void *block);
+
+/// <summary>
+///     Initializes an arena over size bytes of storage, charged against the tag's budget.
+/// </summary>
+/// <returns>0 on success, or -1 if the tag's budget does not allow it</returns>
+int MemArena_Init(MemArena *arena, MemTag tag, void *storage, size_t size);
+
+/// <summary>
+///     Returns the arena's storage to its tag's budget, releasing everything allocated
+///     from it; the arena is empty afterwards and may be initialized again.
+/// </summary>
+void MemArena_Deinit(MemArena *arena);
+
+/// <summary>
+///     Allocates bytes from the arena, aligned for any scalar type.
+/// </summary>
+/// <returns>The memory, or NULL if the arena is exhausted (counted in the memory report)</returns>
+void *MemArena_Alloc(MemArena *arena, size_t bytes);
+
+/// <summary>
+///     Current arena position, to be passed to MemArena_Reset later.
+/// </summary>
+MemArenaMark MemArena_Mark(const MemArena *arena);
+
+/// <summary>
+///     Releases everything allocated since the mark was taken.
+/// </summary>
+void MemArena_Reset(MemArena *arena, MemArenaMark mark);
@@ -0,0 +1,123 @@
+/* Licensed under the MIT License. */
+
+#include <stdint.h>
+#include <applibs/log.h>
+#include "mem_stats.h"
+
+static const char *const tagNames[MemTag_Count] = {
+    [MemTag_Parser] = "parser",
+    [MemTag_Uart] = "uart",
+    [MemTag_Index] = "index",
+    [MemTag_Other] = "other",
+};
+
+static size_t inUse[MemTag_Count];
+static size_t peak[MemTag_Count];
+static size_t budget[MemTag_Count];
+static unsigned long exhausted[MemTag_Count];
+
+// Painted stack region: [paintLow, paintLow + paintDepth). Kept as an address
+// range rather than a pointer, since the frame that painted it is gone; the
+// stack memory itself stays mapped for the life of the thread
+static const uint8_t stackPaint = 0xA5;
+static uintptr_t paintLow;
+static size_t paintDepth;
+
+void MemStats_Add(MemTag tag, size_t bytes)
+{
+    if (tag < 0 || tag >= MemTag_Count) {
+        tag = MemTag_Other;
+    }
+    inUse[tag] += bytes;
+    if (inUse[tag] > peak[tag]) {
+        peak[tag] = inUse[tag];
+    }
+}
+
+void MemStats_Release(MemTag tag, size_t bytes)
+{
+    if (tag < 0 || tag >= MemTag_Count) {
+        tag = MemTag_Other;
+    }
+    inUse[tag] = bytes > inUse[tag] ? 0 : inUse[tag] - bytes;
+}
+
+size_t MemStats_InUse(MemTag tag)
+{
+    return (tag >= 0 && tag < MemTag_Count) ? inUse[tag] : 0;
+}
+
+void MemStats_SetBudget(MemTag tag, size_t bytes)
+{
+    if (tag >= 0 && tag < MemTag_Count) {
+        budget[tag] = bytes;
+    }
+}
+
+bool MemStats_Reserve(MemTag tag, size_t bytes)
+{
+    if (tag < 0 || tag >= MemTag_Count) {
+        tag = MemTag_Other;
+    }
+    if (budget[tag] != 0 && (inUse[tag] >= budget[tag] || bytes > budget[tag] - inUse[tag])) {
+        exhausted[tag]++;
+        return false;
+    }
+    MemStats_Add(tag, bytes);
+    return true;
+}
+
+void MemStats_NoteExhausted(MemTag tag)
+{
+    if (tag < 0 || tag >= MemTag_Count) {
+        tag = MemTag_Other;
+    }
+    exhausted[tag]++;
+}
+
+// Kept out of line so its frame sits below the caller's and the painted
+// region is stack the caller's callees will use later
+static void __attribute__((noinline)) PaintBelowCaller(size_t depth)
+{
+    volatile uint8_t region[depth];
+    for (size_t i = 0; i < depth; i++) {
+        region[i] = stackPaint;
+    }
+    paintLow = (uintptr_t)region;
+}
+
+void __attribute__((noinline)) MemStats_PaintStack(size_t depth)
+{
+    PaintBelowCaller(depth);
+
+    // Measure up to this frame, which sits just above the painted region
+    uintptr_t top = (uintptr_t)__builtin_frame_address(0);
+    paintDepth = top > paintLow ? top - paintLow : 0;
+}
+
+size_t MemStats_StackHighWater(void)
+{
+    if (paintDepth == 0) {
+        return 0;
+    }
+
+    // The stack grows down, so untouched paint remains at the low end
+    const volatile uint8_t *low = (const volatile uint8_t *)paintLow;
+    size_t untouched = 0;
+    while (untouched < paintDepth && low[untouched] == stackPaint) {
+        untouched++;
+    }
+    return paintDepth - untouched;
+}
+
+void MemStats_Report(void)
+{
+    Log_Debug("Memory use (bytes, current/peak/budget, exhausted):\n");
+    for (int i = 0; i < MemTag_Count; i++) {
+        Log_Debug("  %-8s %6zu / %6zu / %6zu, %lu\n", tagNames[i], inUse[i], peak[i], budget[i],
+                  exhausted[i]);
+    }
+    if (paintDepth != 0) {
+        Log_Debug("  stack high-water %zu of %zu measured\n", MemStats_StackHighWater(), paintDepth);
+    }
+}
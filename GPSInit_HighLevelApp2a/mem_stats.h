@@ -0,0 +1,77 @@
+/* Licensed under the MIT License. */
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+/// <summary>
+///     Subsystems that memory is accounted against.
+/// </summary>
+typedef enum {
+    MemTag_Parser,      ///< NMEA parser contexts
+    MemTag_Uart,        ///< UART receive/transmit buffers
+    MemTag_Index,       ///< spatial indexes and aggregators
+    MemTag_Other,
+    MemTag_Count
+} MemTag;
+
+/// <summary>
+///     Accounts bytes as in use by a subsystem, e.g. when a buffer is allocated or
+///     a statically sized object is set up.
+/// </summary>
+/// <param name="tag">Subsystem owning the memory</param>
+/// <param name="bytes">Number of bytes</param>
+void MemStats_Add(MemTag tag, size_t bytes);
+
+/// <summary>
+///     Returns bytes previously accounted with MemStats_Add.
+/// </summary>
+/// <param name="tag">Subsystem owning the memory</param>
+/// <param name="bytes">Number of bytes</param>
+void MemStats_Release(MemTag tag, size_t bytes);
+
+/// <summary>
+///     Sets the most memory a subsystem may reserve with MemStats_Reserve; 0 means
+///     unlimited. Budgets are configured once at init.
+/// </summary>
+/// <param name="tag">Subsystem</param>
+/// <param name="bytes">Budget in bytes</param>
+void MemStats_SetBudget(MemTag tag, size_t bytes);
+
+/// <summary>
+///     Accounts bytes to a subsystem if that keeps it within its budget.
+/// </summary>
+/// <param name="tag">Subsystem owning the memory</param>
+/// <param name="bytes">Number of bytes</param>
+/// <returns>true on success; false, and an exhaustion is recorded, if over budget</returns>
+bool MemStats_Reserve(MemTag tag, size_t bytes);
+
+/// <summary>
+///     Records that an allocation for a subsystem failed because its pool, arena or
+///     budget was exhausted. Reported by MemStats_Report.
+/// </summary>
+void MemStats_NoteExhausted(MemTag tag);
+
+/// <summary>
+///     Bytes currently accounted to a subsystem.
+/// </summary>
+size_t MemStats_InUse(MemTag tag);
+
+/// <summary>
+///     Fills the stack below the caller's frame with a known pattern so
+///     MemStats_StackHighWater can later find how deep the stack has reached.
+///     Call once, early, from the thread to be measured (the event loop).
+/// </summary>
+/// <param name="depth">Bytes of stack to paint; must fit within the thread's stack</param>
+void MemStats_PaintStack(size_t depth);
+
+/// <summary>
+///     Deepest stack use seen below the frame that called MemStats_PaintStack, in bytes.
+///     Returns 0 if the stack was never painted.
+/// </summary>
+size_t MemStats_StackHighWater(void);
+
+/// <summary>
+///     Logs current and peak use per subsystem and the stack high-water mark.
+/// </summary>
+void MemStats_Report(void);
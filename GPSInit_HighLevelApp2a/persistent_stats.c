@@ -0,0 +1,175 @@
+/* Licensed under the MIT License. */
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <applibs/log.h>
+#include <applibs/storage.h>
+#include "persistent_stats.h"
+#include "tinygps.h"
+
+#define STATS_MAGIC 0x53505347 // "GPSS"
+#define STATS_VERSION 1
+
+_Static_assert(sizeof(PersistentStatsRecord) <= PERSISTENT_STATS_STORAGE_SIZE,
+               "stats record overlaps the ephemeris copy");
+
+static int storageFd = -1;
+static PersistentStatsRecord record;
+static bool dirty;
+static time_t lastFlush;
+static unsigned int flushInterval;
+
+// Parser counters at the previous sample; deltas are taken in the parser's own widths
+static unsigned long lastChars;
+static unsigned short lastGood;
+static unsigned short lastFailed;
+
+static uint32_t Crc32(const void *data, size_t length)
+{
+    const uint8_t *p = data;
+    uint32_t crc = 0xFFFFFFFF;
+
+    while (length--) {
+        crc ^= *p++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t RecordChecksum(const PersistentStatsRecord *r)
+{
+    return Crc32(r, offsetof(PersistentStatsRecord, checksum));
+}
+
+static time_t MonotonicSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+int PersistentStats_Open(unsigned int minFlushIntervalSeconds)
+{
+    flushInterval = minFlushIntervalSeconds;
+    lastFlush = MonotonicSeconds();
+    memset(&record, 0, sizeof(record));
+
+    storageFd = Storage_OpenMutableFile();
+    if (storageFd < 0) {
+        Log_Debug("ERROR: Could not open mutable storage: %s (%d).\n", strerror(errno), errno);
+        return -1;
+    }
+
+    PersistentStatsRecord stored;
+    ssize_t bytesRead = pread(storageFd, &stored, sizeof(stored), 0);
+    if (bytesRead == sizeof(stored) && stored.magic == STATS_MAGIC &&
+        stored.version == STATS_VERSION && stored.size == sizeof(stored) &&
+        stored.checksum == RecordChecksum(&stored)) {
+        record = stored;
+    } else if (bytesRead != 0) {
+        Log_Debug("Persistent stats missing or corrupt, starting from zero\n");
+    }
+
+    record.magic = STATS_MAGIC;
+    record.version = STATS_VERSION;
+    record.size = sizeof(record);
+    record.bootCount++;
+    dirty = true;
+
+    gps_stats(&lastChars, &lastGood, &lastFailed);
+
+    // Write the boot count now; the flush interval only limits later writes
+    PersistentStats_Flush(true);
+    return 0;
+}
+
+void PersistentStats_SampleParser(void)
+{
+    unsigned long chars;
+    unsigned short good, failed;
+
+    gps_stats(&chars, &good, &failed);
+    if (chars == lastChars) {
+        return;
+    }
+    record.encodedCharacters += chars - lastChars;
+    record.goodSentences += (unsigned short)(good - lastGood);
+    record.failedChecksum += (unsigned short)(failed - lastFailed);
+    lastChars = chars;
+    lastGood = good;
+    lastFailed = failed;
+    dirty = true;
+}
+
+void PersistentStats_AddUartBytes(uint32_t bytes)
+{
+    if (bytes != 0) {
+        record.uartBytes += bytes;
+        dirty = true;
+    }
+}
+
+void PersistentStats_RecordTtff(uint32_t ttffMs)
+{
+    record.lastTtffMs = ttffMs;
+    if (record.bestTtffMs == 0 || ttffMs < record.bestTtffMs) {
+        record.bestTtffMs = ttffMs;
+    }
+    dirty = true;
+
+    // Once per boot, and the reason the counters exist: write it without waiting
+    PersistentStats_Flush(true);
+}
+
+int PersistentStats_Flush(bool force)
+{
+    if (storageFd < 0 || !dirty) {
+        return 0;
+    }
+    time_t now = MonotonicSeconds();
+    if (!force && now - lastFlush < (time_t)flushInterval) {
+        return 0;
+    }
+
+    record.checksum = RecordChecksum(&record);
+    if (pwrite(storageFd, &record, sizeof(record), 0) != sizeof(record)) {
+        Log_Debug("ERROR: Could not write persistent stats: %s (%d).\n", strerror(errno), errno);
+        return -1;
+    }
+    dirty = false;
+    lastFlush = now;
+    return 0;
+}
+
+const PersistentStatsRecord *PersistentStats_Get(void)
+{
+    return &record;
+}
+
+void PersistentStats_Report(void)
+{
+    uint64_t checked = record.goodSentences + record.failedChecksum;
+
+    Log_Debug("Lifetime: %lu boots, %llu chars, %llu good sentences, %llu failed checksums",
+              (unsigned long)record.bootCount, (unsigned long long)record.encodedCharacters,
+              (unsigned long long)record.goodSentences, (unsigned long long)record.failedChecksum);
+    if (checked != 0) {
+        Log_Debug(" (%.3f%%)", 100.0 * (double)record.failedChecksum / (double)checked);
+    }
+    Log_Debug("; TTFF last %lu ms, best %lu ms\n", (unsigned long)record.lastTtffMs,
+              (unsigned long)record.bestTtffMs);
+}
+
+void PersistentStats_Close(void)
+{
+    PersistentStats_Flush(true);
+    if (storageFd >= 0) {
+        close(storageFd);
+        storageFd = -1;
+    }
+}
@@ -0,0 +1,80 @@
+/* Licensed under the MIT License. */
+
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+/// <summary>
+/// <para>Lifetime counters kept in the app's mutable storage file so error rates can be
+/// tracked across restarts.</para>
+/// <para>The record is updated in RAM as the parser and event loop run, and written
+/// back only when it has changed and the flush interval has passed, to limit flash
+/// wear.</para>
+/// </summary>
+typedef struct PersistentStatsRecord {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    uint32_t bootCount;
+    uint32_t lastTtffMs;            ///< time to first fix of the most recent boot that got one
+    uint32_t bestTtffMs;
+    uint32_t reserved;
+    uint64_t encodedCharacters;     ///< parser gps_stats() totals
+    uint64_t goodSentences;
+    uint64_t failedChecksum;
+    uint64_t uartBytes;             ///< bytes read from the UART by the event loop
+    uint32_t checksum;              ///< CRC-32 of all preceding fields
+} PersistentStatsRecord;
+
+/// Bytes at the start of the mutable storage file kept for the record; the extended
+/// ephemeris copy follows them
+#define PERSISTENT_STATS_STORAGE_SIZE 256
+
+/// <summary>
+///     Opens the mutable storage file and resumes the counters from the last
+///     checkpoint. A missing or corrupt record starts from zero. Counts this boot and
+///     writes the record straight away; the flush interval applies from then on.
+/// </summary>
+/// <param name="minFlushIntervalSeconds">Minimum time between writes to flash</param>
+/// <returns>0 on success, or -1 if the storage file cannot be opened</returns>
+int PersistentStats_Open(unsigned int minFlushIntervalSeconds);
+
+/// <summary>
+///     Folds the parser statistics accumulated since the last call into the lifetime
+///     counters. Call at least every few thousand sentences, e.g. per UART event, so
+///     the parser's 16-bit counters cannot wrap between samples.
+/// </summary>
+void PersistentStats_SampleParser(void);
+
+/// <summary>
+///     Adds bytes received by the event loop.
+/// </summary>
+void PersistentStats_AddUartBytes(uint32_t bytes);
+
+/// <summary>
+///     Records this boot's time to first fix and writes the record straight away.
+/// </summary>
+void PersistentStats_RecordTtff(uint32_t ttffMs);
+
+/// <summary>
+///     Writes the record if it changed since the last write and either force is set or
+///     the minimum flush interval has passed.
+/// </summary>
+/// <param name="force">Write regardless of the interval, e.g. on shutdown</param>
+/// <returns>0 on success or if nothing needed writing, -1 on write failure</returns>
+int PersistentStats_Flush(bool force);
+
+/// <summary>
+///     Lifetime counters as currently held in RAM.
+/// </summary>
+const PersistentStatsRecord *PersistentStats_Get(void);
+
+/// <summary>
+///     Logs the lifetime counters and checksum failure rate.
+/// </summary>
+void PersistentStats_Report(void);
+
+/// <summary>
+///     Flushes pending changes and closes the storage file.
+/// </summary>
+void PersistentStats_Close(void);
@@ -0,0 +1,183 @@
+/*
+gps_geo_check - host accuracy check for gps_geo. Not part of the device
+build; compile and run on a development machine from this directory:
+
+  cc -O2 -I.. gps_geo_check.c ../gps_geo.c -lm -o gps_geo_check
+  ./gps_geo_check
+
+Prints the worst error of each transform and exits non-zero if any
+exceeds the accuracy gps_geo.h documents:
+- geodetic -> ECEF -> geodetic round trip over the globe, -100 m to 9 km
+- UTM round trip across a whole zone, and the forward transform against
+  an independent series (Snyder, USGS Professional Paper 1395) with the
+  meridian arc integrated numerically
+- fixed-point ENU against the exact ENU through ECEF, at 1, 10 and 50 km
+  from references at several latitudes, and the fixed-point inverse
+  against the position it started from
+*/
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "gps_geo.h"
+
+#define DEG (3.14159265358979323846 / 180)
+#define METERS_PER_DEGREE 111320.0
+
+static int failures;
+
+static void check(const char *what, double worst, double bound, const char *unit)
+{
+  bool ok = worst <= bound;
+  printf("%-44s %10.3g %s (bound %g)%s\n", what, worst, unit, bound, ok ? "" : "  FAIL");
+  if (!ok)
+    ++failures;
+}
+
+static void check_ecef(void)
+{
+  double worst = 0;
+  for (double lat = -89.9; lat < 90; lat += 7.3)
+    for (double lon = -179; lon < 180; lon += 13.7)
+      for (double height = -100; height < 10000; height += 3000)
+      {
+        double ecef[3], lat2, lon2, height2;
+        gps_ecef_from_geodetic(lat, lon, height, ecef);
+        gps_geodetic_from_ecef(ecef, &lat2, &lon2, &height2);
+        double err = fabs(lat2 - lat) * METERS_PER_DEGREE +
+          fabs(lon2 - lon) * METERS_PER_DEGREE * cos(lat * DEG) + fabs(height2 - height);
+        if (err > worst)
+          worst = err;
+      }
+  check("ECEF round trip", worst, 1e-6, "m");
+}
+
+// Meridian arc from the equator, by Simpson's rule; Snyder's e^6 series
+// for it is only good to a centimeter near the poles
+static double meridian_arc(double phi)
+{
+  const double a = GPS_WGS84_A, f = GPS_WGS84_F;
+  const int steps = 2000;
+  double e2 = f * (2 - f), h = phi / steps, sum = 0;
+  for (int i = 0; i <= steps; ++i)
+  {
+    double s = sin(i * h), w = i == 0 || i == steps ? 1 : i % 2 ? 4 : 2;
+    sum += w * a * (1 - e2) / pow(1 - e2 * s * s, 1.5);
+  }
+  return sum * h / 3;
+}
+
+// Snyder's transverse Mercator series (equations 8-9, 8-10) with the UTM
+// scale, false easting and false northing
+static void snyder_utm(double lat, double lon, int zone, double *easting, double *northing)
+{
+  const double a = GPS_WGS84_A, f = GPS_WGS84_F, k0 = 0.9996;
+  double e2 = f * (2 - f), ep2 = e2 / (1 - e2);
+  double phi = lat * DEG, lam0 = (zone * 6 - 183) * DEG;
+  double s = sin(phi), c = cos(phi), t = tan(phi);
+  double n = a / sqrt(1 - e2 * s * s), tt = t * t, cc = ep2 * c * c;
+  double aa = (lon * DEG - lam0) * c;
+  double m = meridian_arc(phi);
+  *easting = 500000 + k0 * n * (aa + (1 - tt + cc) * pow(aa, 3) / 6
+    + (5 - 18 * tt + tt * tt + 72 * cc - 58 * ep2) * pow(aa, 5) / 120);
+  *northing = k0 * (m + n * t * (aa * aa / 2 + (5 - tt + 9 * cc + 4 * cc * cc) * pow(aa, 4) / 24
+    + (61 - 58 * tt + tt * tt + 600 * cc - 330 * ep2) * pow(aa, 6) / 720));
+  if (lat < 0)
+    *northing += 10000000;
+}
+
+static void check_utm(void)
+{
+  double worst_round = 0, worst_ref = 0;
+  const int zone = 31; // central meridian 3 degrees east
+  for (double lat = -80; lat <= 84; lat += 3.1)
+    for (double dl = -3; dl <= 3; dl += 0.5)
+    {
+      double lon = 3 + dl, easting, northing, lat2, lon2;
+      gps_utm_from_geodetic(lat, lon, zone, &easting, &northing);
+      gps_geodetic_from_utm(easting, northing, zone, lat < 0, &lat2, &lon2);
+      double err = (fabs(lat2 - lat) + fabs(lon2 - lon) * cos(lat * DEG)) * METERS_PER_DEGREE;
+      if (err > worst_round)
+        worst_round = err;
+
+      double ref_easting, ref_northing;
+      snyder_utm(lat, lon, zone, &ref_easting, &ref_northing);
+      err = hypot(easting - ref_easting, northing - ref_northing);
+      if (err > worst_ref)
+        worst_ref = err;
+    }
+  check("UTM round trip", worst_round, 1e-4, "m");
+  check("UTM against Snyder series", worst_ref, 1e-3, "m");
+
+  bool zones = gps_utm_zone(60, 5) == 32 && gps_utm_zone(78, 10) == 33 &&
+    gps_utm_zone(48.1173, 11.5167) == 32 && gps_utm_zone(-33.8568, 151.2153) == 56;
+  check("UTM zone exceptions", zones ? 0 : 1, 0, "wrong");
+}
+
+// Worst errors of the fixed-point kernels on a circle of the given radius
+// around a reference
+static void fixed_enu_errors(double ref_lat, double ref_lon, double radius,
+  double *forward, double *inverse)
+{
+  gps_enu_ref ref;
+  gps_enu_init(&ref, ref_lat, ref_lon, 0);
+  *forward = *inverse = 0;
+  for (int k = 0; k < 64; ++k)
+  {
+    double angle = k * 2 * 3.14159265358979323846 / 64, d = radius / METERS_PER_DEGREE;
+    long lat = lrint((ref_lat + d * sin(angle)) * GPS_ANGLE_SCALE);
+    long lon = lrint((ref_lon + d * cos(angle) / cos(ref_lat * DEG)) * GPS_ANGLE_SCALE);
+    double exact[3];
+    gps_enu_from_geodetic(&ref, (double)lat / GPS_ANGLE_SCALE, (double)lon / GPS_ANGLE_SCALE, 0,
+      exact);
+
+    long east_mm, north_mm, lat2, lon2;
+    gps_enu_from_fixed(&ref, lat, lon, &east_mm, &north_mm);
+    double err = hypot(east_mm / 1000.0 - exact[0], north_mm / 1000.0 - exact[1]);
+    if (err > *forward)
+      *forward = err;
+
+    gps_fixed_from_enu(&ref, east_mm, north_mm, &lat2, &lon2);
+    err = (labs(lat2 - lat) + labs(lon2 - lon) * cos(ref_lat * DEG)) * METERS_PER_DEGREE /
+      GPS_ANGLE_SCALE;
+    if (err > *inverse)
+      *inverse = err;
+  }
+}
+
+static void check_fixed_enu(void)
+{
+  // mid latitudes, both hemispheres, and the equator
+  static const double refs[][2] = { { 48.1173, 11.5167 }, { -33.9, 151.2 }, { 0.1, -0.2 } };
+  static const double radii[3] = { 1e3, 1e4, 5e4 };
+  double worst[3] = { 0, 0, 0 }, worst_inverse[3] = { 0, 0, 0 };
+
+  for (size_t r = 0; r < sizeof(refs) / sizeof(refs[0]); ++r)
+    for (int i = 0; i < 3; ++i)
+    {
+      double forward, inverse;
+      fixed_enu_errors(refs[r][0], refs[r][1], radii[i], &forward, &inverse);
+      if (forward > worst[i])
+        worst[i] = forward;
+      if (inverse > worst_inverse[i])
+        worst_inverse[i] = inverse;
+    }
+  check("fixed-point ENU at 1 km, mid latitudes", worst[0], 0.005, "m");
+  check("fixed-point ENU at 10 km, mid latitudes", worst[1], 0.015, "m");
+  check("fixed-point ENU at 50 km, mid latitudes", worst[2], 1.5, "m");
+  check("fixed-point inverse at 10 km, mid latitudes", worst_inverse[1], 0.05, "m");
+  check("fixed-point inverse at 50 km, mid latitudes", worst_inverse[2], 3, "m");
+
+  double forward, inverse;
+  fixed_enu_errors(70, 25, 5e4, &forward, &inverse);
+  check("fixed-point ENU at 50 km, 70 degrees", forward, 5.5, "m");
+}
+
+int main(void)
+{
+  check_ecef();
+  check_utm();
+  check_fixed_enu();
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
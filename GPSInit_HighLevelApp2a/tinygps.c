@@ -22,39 +22,12 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <math.h>
 #include <time.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include "tinygps.h"
 
-// properties
-unsigned long _time, _new_time;
-unsigned long _date, _new_date;
-long _latitude, _new_latitude;
-long _longitude, _new_longitude;
-long _altitude, _new_altitude;
-unsigned long  _speed, _new_speed;
-unsigned long  _course, _new_course;
-unsigned long  _hdop, _new_hdop;
-unsigned short _numsats, _new_numsats;
-
-unsigned long _last_time_fix, _new_time_fix;
-unsigned long _last_position_fix, _new_position_fix;
-
-// parsing state variables
-byte _parity;
-bool _is_checksum_term;
-char _term[15];
-byte _sentence_type;
-byte _term_number = 0;
-byte _term_offset = 0;
-bool _is_gps_data_good;
-
-#ifndef GPS_NO_STATS
-  // statistics
-  unsigned long _encoded_characters;
-  unsigned short _good_sentences;
-  unsigned short _failed_checksum;
-  unsigned short _passed_checksum;
-#endif
+// default parser instance behind the non-reentrant gps_* API
+static gps_parser _gps = GPS_PARSER_INIT;
 
 //
 // public methods
@@ -64,19 +37,19 @@ bool _is_gps_data_good;
 bool gpsisdigit(char c) { return c >= '0' && c <= '9'; }
 
 // signed altitude in centimeters (from GPGGA sentence)
-inline long altitude(void) { return _altitude; }
+static inline long altitude(void) { gps_fix fix; gps_get_fix(&fix); return fix.altitude; }
 
 // course in last full GPRMC sentence in 100th of a degree
-inline unsigned long course(void) { return _course; }
+static inline unsigned long course(void) { gps_fix fix; gps_get_fix(&fix); return fix.course; }
 
 // speed in last full GPRMC sentence in 100ths of a knot
-inline unsigned long speed(void) { return _speed; }
+static inline unsigned long speed(void) { gps_fix fix; gps_get_fix(&fix); return fix.speed; }
 
 // satellites used in last full GPGGA sentence
-inline unsigned short gps_satellites(void) { return _numsats; }
+static inline unsigned short gps_satellites(void) { gps_fix fix; gps_get_fix(&fix); return fix.numsats; }
 
 // horizontal dilution of precision in 100ths
-inline unsigned long gps_hdop(void) { return _hdop; }
+static inline unsigned long gps_hdop(void) { gps_fix fix; gps_get_fix(&fix); return fix.hdop; }
 
 
 clock_t uptime(void)
@@ -94,58 +67,128 @@ float degrees(float rad)
 	return rad * (180/PI);
 }
 
+void gps_parser_init(gps_parser *gps)
+{
+  static const gps_parser initial = GPS_PARSER_INIT;
+  *gps = initial;
+}
+
 bool gps_encode(char c)
+{
+  return gps_encode_r(&_gps, c);
+}
+
+/* NMEA framing is a small state machine over five character classes.
+ * gps_char_class maps every byte to its class at compile time and
+ * gps_next_checksum_state gives the next "inside the checksum term" state
+ * for each (state, class) pair. Ordinary characters, which are the vast
+ * majority, are then handled without any data-dependent branches; only the
+ * delimiters fall through to the term/sentence actions below.
+ */
+const byte gps_char_class[256] = {
+  [','] = GPS_CC_COMMA, ['\r'] = GPS_CC_END, ['\n'] = GPS_CC_END,
+  ['*'] = GPS_CC_STAR, ['$'] = GPS_CC_DOLLAR
+};
+
+static const bool gps_next_checksum_state[2][GPS_CC_COUNT] = {
+  //  ORDINARY COMMA  END    STAR   DOLLAR
+  { false,   false, false, true,  false }, // in a data term
+  { true,    false, false, true,  false }  // in the checksum term
+};
+
+// append an ordinary character to the current term. Past the end of _term
+// the last slot is overwritten; gps_end_term() terminates the string there,
+// so the term is truncated exactly as before. Characters of the checksum
+// term are masked out of the parity
+static inline void gps_lex_ordinary(gps_parser *gps, char c)
+{
+  byte offset = gps->_term_offset;
+  gps->_term[offset] = c;
+  gps->_term_offset = offset + (offset < sizeof(gps->_term) - 1);
+  gps->_parity ^= c & (byte)(gps->_is_checksum_term - 1);
+}
+
+static bool gps_lex_delimiter(gps_parser *gps, char c, byte cls)
 {
   bool valid_sentence = false;
 
+  if (cls == GPS_CC_DOLLAR)
+  {
+    gps->_term_number = 0;
+    gps->_term_offset = 0;
+    gps->_parity = 0;
+    gps->_sentence_type = GPS_SENTENCE_OTHER;
+    gps->_is_checksum_term = false;
+    gps->_is_gps_data_good = false;
+    return false;
+  }
+
+  if (cls == GPS_CC_COMMA)
+    gps->_parity ^= c;
+  gps->_term[gps->_term_offset] = 0;
+  valid_sentence = gps_term_complete(gps);
+  ++gps->_term_number;
+  gps->_term_offset = 0;
+  gps->_is_checksum_term = gps_next_checksum_state[gps->_is_checksum_term][cls];
+  return valid_sentence;
+}
+
+bool gps_encode_r(gps_parser *gps, char c)
+{
+  byte cls = gps_char_class[(byte)c];
+
 #ifndef GPS_NO_STATS
-  _encoded_characters++;
+  gps->_encoded_characters++;
 #endif
-  switch(c)
+  if (cls == GPS_CC_ORDINARY)
   {
-  case ',': // term terminators
-    _parity ^= c;
-  case '\r':
-  case '\n':
-  case '*':
-    if (_term_offset < sizeof(_term))
-    {
-      _term[_term_offset] = 0;
-      valid_sentence = gps_term_complete();
-    }
-    ++_term_number;
-    _term_offset = 0;
-    _is_checksum_term = c == '*';
-    return valid_sentence;
-
-  case '$': // sentence begin
-    _term_number = 0;
-    _term_offset = 0;
-    _parity = 0;
-    _sentence_type = GPS_SENTENCE_OTHER;
-    _is_checksum_term = false;
-    _is_gps_data_good = false;
-    return valid_sentence;
+    gps_lex_ordinary(gps, c);
+    return false;
   }
+  return gps_lex_delimiter(gps, c, cls);
+}
+
+unsigned int gps_encode_buffer(const char *buf, unsigned int len)
+{
+  return gps_encode_buffer_r(&_gps, buf, len);
+}
 
-  // ordinary characters
-  if (_term_offset < sizeof(_term) - 1)
-    _term[_term_offset++] = c;
-  if (!_is_checksum_term)
-    _parity ^= c;
+unsigned int gps_encode_buffer_r(gps_parser *gps, const char *buf, unsigned int len)
+{
+  unsigned int sentences = 0;
+  const char *end = buf + len;
 
-  return valid_sentence;
+#ifndef GPS_NO_STATS
+  gps->_encoded_characters += len;
+#endif
+  while (buf < end)
+  {
+    // runs of ordinary characters stay in this loop
+    byte cls = GPS_CC_ORDINARY;
+    while (buf < end && (cls = gps_char_class[(byte)*buf]) == GPS_CC_ORDINARY)
+      gps_lex_ordinary(gps, *buf++);
+    if (buf == end)
+      break;
+    if (gps_lex_delimiter(gps, *buf++, cls))
+      ++sentences;
+  }
+  return sentences;
 }
 
 #ifndef GPS_NO_STATS
 void gps_stats(unsigned long *chars, unsigned short *sentences, unsigned short *failed_cs)
+{
+  gps_stats_r(&_gps, chars, sentences, failed_cs);
+}
+
+void gps_stats_r(const gps_parser *gps, unsigned long *chars, unsigned short *sentences, unsigned short *failed_cs)
 {
   if (chars)
-	*chars = _encoded_characters;
+	*chars = gps->_encoded_characters;
   if (sentences)
-	*sentences = _good_sentences;
+	*sentences = gps->_good_sentences;
   if (failed_cs)
-	*failed_cs = _failed_checksum;
+	*failed_cs = gps->_failed_checksum;
 }
 #endif
 
@@ -163,13 +206,13 @@ int from_hex(char a)
     return a - '0';
 }
 
-unsigned long gps_parse_decimal()
+unsigned long gps_parse_decimal(const gps_parser *gps)
 {
-  char *p;
+  const char *p;
   bool isneg;
   unsigned long ret;
 
-  p = _term;
+  p = gps->_term;
   isneg = (*p == '-');
   if (isneg)
 	++p;
@@ -191,69 +234,196 @@ unsigned long gps_parse_decimal()
   return isneg ? -ret : ret;
 }
 
-unsigned long gps_parse_degrees()
+// [d]ddmm.mmmm... to 10^-7 degree. Minutes are taken to 7 decimals, more than
+// any receiver sends, and rounded once when converted to degrees
+unsigned long gps_parse_degrees(const gps_parser *gps)
 {
-  char *p;
+  const char *p;
   unsigned long left;
-  unsigned long tenk_minutes;
+  unsigned long minutes;              // 10^-7 minute
 
-  left = gpsatol(_term);
-  tenk_minutes = (left % 100UL) * 10000UL;
+  left = gpsatol(gps->_term);
+  minutes = (left % 100UL) * 10000000UL;
 
-  for (p=_term; gpsisdigit(*p); ++p);
+  for (p=gps->_term; gpsisdigit(*p); ++p);
 
   if (*p == '.')
   {
-    unsigned long mult = 1000;
-    while (gpsisdigit(*++p))
+    unsigned long mult = 1000000;
+    while (gpsisdigit(*++p) && mult)
     {
-      tenk_minutes += mult * (*p - '0');
+      minutes += mult * (*p - '0');
       mult /= 10;
     }
   }
-  return (left / 100) * 100000 + tenk_minutes / 6;
+  return (left / 100) * GPS_ANGLE_SCALE + (minutes + 30) / 60;
+}
+
+/* Publishes a new fix under the sequence counter (seqlock write side).
+ * Readers that observe an odd or changed sequence retry, so the writer
+ * never waits for them.
+ */
+static void gps_commit_fix(gps_parser *gps, const gps_fix *fix)
+{
+  __atomic_store_n(&gps->_fix_seq, gps->_fix_seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  gps->_fix = *fix;
+  __atomic_store_n(&gps->_fix_seq, gps->_fix_seq + 1, __ATOMIC_RELEASE);
+}
+
+/* Sentence schemas. Each enabled sentence type lists its terms once, as
+ * rows of an X-macro: FIELD(term, decoder, member) stores a decoded value
+ * in a gps_parser member, FLAG(term, decoder) lets the decoder update the
+ * parser itself. The list expands into a switch on the term number in that
+ * sentence's decoder, so every field is a direct call the compiler can
+ * inline. Defining GPS_NO_GPRMC or GPS_NO_GPGGA drops a sentence's schema
+ * (and its commit code) from the build entirely.
+ */
+static inline unsigned long gps_decode_decimal(const gps_parser *gps)
+{
+  return gps_parse_decimal(gps);
+}
+
+static inline unsigned long gps_decode_integer(const gps_parser *gps)
+{
+  return gpsatol(gps->_term);
+}
+
+static inline unsigned short gps_decode_count(const gps_parser *gps)
+{
+  return (unsigned char)atoi(gps->_term);
+}
+
+static inline void gps_decode_time(gps_parser *gps)
+{
+  gps->_new_time = gps_parse_decimal(gps);
+  gps->_new_time_fix = uptime();
+}
+
+static inline void gps_decode_latitude(gps_parser *gps)
+{
+  gps->_new_latitude = gps_parse_degrees(gps);
+  gps->_new_position_fix = uptime();
+}
+
+static inline void gps_decode_longitude(gps_parser *gps)
+{
+  gps->_new_longitude = gps_parse_degrees(gps);
+}
+
+static inline void gps_decode_north_south(gps_parser *gps)
+{
+  if (gps->_term[0] == 'S')
+    gps->_new_latitude = -gps->_new_latitude;
+}
+
+static inline void gps_decode_east_west(gps_parser *gps)
+{
+  if (gps->_term[0] == 'W')
+    gps->_new_longitude = -gps->_new_longitude;
+}
+
+static inline void gps_decode_rmc_status(gps_parser *gps)
+{
+  gps->_is_gps_data_good = (gps->_term[0] == 'A');
+}
+
+static inline void gps_decode_gga_quality(gps_parser *gps)
+{
+  gps->_is_gps_data_good = (gps->_term[0] > '0');
+  gps->_new_quality = gpsisdigit(gps->_term[0]) ? (byte)(gps->_term[0] - '0') : GPS_INVALID_QUALITY;
+}
+
+#define GPS_CASE_FIELD(term, decoder, member) case term: gps->member = decoder(gps); break;
+#define GPS_CASE_FLAG(term, decoder) case term: decoder(gps); break;
+
+#ifndef GPS_NO_GPRMC
+#define GPS_GPRMC_SCHEMA(FIELD, FLAG) \
+  FLAG(1, gps_decode_time)                            /* time */ \
+  FLAG(2, gps_decode_rmc_status)                      /* validity */ \
+  FLAG(3, gps_decode_latitude)                        /* latitude */ \
+  FLAG(4, gps_decode_north_south)                     /* N/S */ \
+  FLAG(5, gps_decode_longitude)                       /* longitude */ \
+  FLAG(6, gps_decode_east_west)                       /* E/W */ \
+  FIELD(7, gps_decode_decimal, _new_speed)            /* speed */ \
+  FIELD(8, gps_decode_decimal, _new_course)           /* course */ \
+  FIELD(9, gps_decode_integer, _new_date)             /* date */
+
+static inline void gps_decode_gprmc(gps_parser *gps)
+{
+  switch (gps->_term_number)
+  {
+    GPS_GPRMC_SCHEMA(GPS_CASE_FIELD, GPS_CASE_FLAG)
+  }
 }
+#endif
 
-#define COMBINE(sentence_type, term_number) (((unsigned)(sentence_type) << 5) | term_number)
+#ifndef GPS_NO_GPGGA
+#define GPS_GPGGA_SCHEMA(FIELD, FLAG) \
+  FLAG(1, gps_decode_time)                            /* time */ \
+  FLAG(2, gps_decode_latitude)                        /* latitude */ \
+  FLAG(3, gps_decode_north_south)                     /* N/S */ \
+  FLAG(4, gps_decode_longitude)                       /* longitude */ \
+  FLAG(5, gps_decode_east_west)                       /* E/W */ \
+  FLAG(6, gps_decode_gga_quality)                     /* fix quality */ \
+  FIELD(7, gps_decode_count, _new_numsats)            /* satellites used */ \
+  FIELD(8, gps_decode_decimal, _new_hdop)             /* HDOP */ \
+  FIELD(9, gps_decode_decimal, _new_altitude)         /* altitude */
+
+static inline void gps_decode_gpgga(gps_parser *gps)
+{
+  switch (gps->_term_number)
+  {
+    GPS_GPGGA_SCHEMA(GPS_CASE_FIELD, GPS_CASE_FLAG)
+  }
+}
+#endif
 
 /* Processes a just-completed term
  * Returns true if new sentence has just passed checksum test and is validated
  */
-bool gps_term_complete()
+bool gps_term_complete(gps_parser *gps)
 {
-  if (_is_checksum_term)
+  if (gps->_is_checksum_term)
   {
     byte checksum;
-    checksum = 16 * from_hex(_term[0]) + from_hex(_term[1]);
-    if (checksum == _parity)
+    checksum = 16 * from_hex(gps->_term[0]) + from_hex(gps->_term[1]);
+    if (checksum == gps->_parity)
     {
-      if (_is_gps_data_good)
+      if (gps->_is_gps_data_good)
       {
 #ifndef GPS_NO_STATS
-        ++_good_sentences;
+        ++gps->_good_sentences;
 #endif
-        _last_time_fix = _new_time_fix;
-        _last_position_fix = _new_position_fix;
+        gps_fix fix = gps->_fix;
+        fix.last_time_fix = gps->_new_time_fix;
+        fix.last_position_fix = gps->_new_position_fix;
 
-        switch(_sentence_type)
+        switch(gps->_sentence_type)
         {
+#ifndef GPS_NO_GPRMC
         case GPS_SENTENCE_GPRMC:
-          _time      = _new_time;
-          _date      = _new_date;
-          _latitude  = _new_latitude;
-          _longitude = _new_longitude;
-          _speed     = _new_speed;
-          _course    = _new_course;
+          fix.time      = gps->_new_time;
+          fix.date      = gps->_new_date;
+          fix.latitude  = gps->_new_latitude;
+          fix.longitude = gps->_new_longitude;
+          fix.speed     = gps->_new_speed;
+          fix.course    = gps->_new_course;
           break;
+#endif
+#ifndef GPS_NO_GPGGA
         case GPS_SENTENCE_GPGGA:
-          _altitude  = _new_altitude;
-          _time      = _new_time;
-          _latitude  = _new_latitude;
-          _longitude = _new_longitude;
-          _numsats   = _new_numsats;
-          _hdop      = _new_hdop;
+          fix.altitude  = gps->_new_altitude;
+          fix.time      = gps->_new_time;
+          fix.latitude  = gps->_new_latitude;
+          fix.longitude = gps->_new_longitude;
+          fix.numsats   = gps->_new_numsats;
+          fix.hdop      = gps->_new_hdop;
+          fix.quality   = gps->_new_quality;
           break;
+#endif
         }
+        gps_commit_fix(gps, &fix);
 
         return true;
       }
@@ -261,74 +431,41 @@ bool gps_term_complete()
 
 #ifndef GPS_NO_STATS
     else
-      ++_failed_checksum;
+      ++gps->_failed_checksum;
 #endif
     return false;
   }
 
   // the first term determines the sentence type
-  if (_term_number == 0)
+  if (gps->_term_number == 0)
   {
-    if (!gpsstrcmp(_term, GPRMC_TERM))
-      _sentence_type = GPS_SENTENCE_GPRMC;
-    else if (!gpsstrcmp(_term, GPGGA_TERM))
-      _sentence_type = GPS_SENTENCE_GPGGA;
-    else
-      _sentence_type = GPS_SENTENCE_OTHER;
+    gps->_sentence_type = GPS_SENTENCE_OTHER;
+#ifndef GPS_NO_GPRMC
+    if (!gpsstrcmp(gps->_term, GPRMC_TERM))
+      gps->_sentence_type = GPS_SENTENCE_GPRMC;
+#endif
+#ifndef GPS_NO_GPGGA
+    if (!gpsstrcmp(gps->_term, GPGGA_TERM))
+      gps->_sentence_type = GPS_SENTENCE_GPGGA;
+#endif
     return false;
   }
 
-  if (_sentence_type != GPS_SENTENCE_OTHER && _term[0])
-    switch(COMBINE(_sentence_type, _term_number))
+  if (gps->_term[0])
   {
-    case COMBINE(GPS_SENTENCE_GPRMC, 1): // Time in both sentences
-    case COMBINE(GPS_SENTENCE_GPGGA, 1):
-      _new_time = gps_parse_decimal();
-      _new_time_fix = uptime();
-      break;
-    case COMBINE(GPS_SENTENCE_GPRMC, 2): // GPRMC validity
-      _is_gps_data_good = (_term[0] == 'A');
-      break;
-    case COMBINE(GPS_SENTENCE_GPRMC, 3): // Latitude
-    case COMBINE(GPS_SENTENCE_GPGGA, 2):
-      _new_latitude = gps_parse_degrees();
-      _new_position_fix = uptime();
-      break;
-    case COMBINE(GPS_SENTENCE_GPRMC, 4): // N/S
-    case COMBINE(GPS_SENTENCE_GPGGA, 3):
-      if (_term[0] == 'S')
-        _new_latitude = -_new_latitude;
-      break;
-    case COMBINE(GPS_SENTENCE_GPRMC, 5): // Longitude
-    case COMBINE(GPS_SENTENCE_GPGGA, 4):
-      _new_longitude = gps_parse_degrees();
-      break;
-    case COMBINE(GPS_SENTENCE_GPRMC, 6): // E/W
-    case COMBINE(GPS_SENTENCE_GPGGA, 5):
-      if (_term[0] == 'W')
-        _new_longitude = -_new_longitude;
-      break;
-    case COMBINE(GPS_SENTENCE_GPRMC, 7): // Speed (GPRMC)
-      _new_speed = gps_parse_decimal();
-      break;
-    case COMBINE(GPS_SENTENCE_GPRMC, 8): // Course (GPRMC)
-      _new_course = gps_parse_decimal();
-      break;
-    case COMBINE(GPS_SENTENCE_GPRMC, 9): // Date (GPRMC)
-      _new_date = gpsatol(_term);
-      break;
-    case COMBINE(GPS_SENTENCE_GPGGA, 6): // Fix data (GPGGA)
-      _is_gps_data_good = (_term[0] > '0');
-      break;
-    case COMBINE(GPS_SENTENCE_GPGGA, 7): // Satellites used (GPGGA)
-      _new_numsats = (unsigned char)atoi(_term);
-      break;
-    case COMBINE(GPS_SENTENCE_GPGGA, 8): // HDOP
-      _new_hdop = gps_parse_decimal();
+    switch (gps->_sentence_type)
+    {
+#ifndef GPS_NO_GPRMC
+    case GPS_SENTENCE_GPRMC:
+      gps_decode_gprmc(gps);
       break;
-    case COMBINE(GPS_SENTENCE_GPGGA, 9): // Altitude (GPGGA)
-      _new_altitude = gps_parse_decimal();
+#endif
+#ifndef GPS_NO_GPGGA
+    case GPS_SENTENCE_GPGGA:
+      gps_decode_gpgga(gps);
       break;
+#endif
+    }
   }
 
   return false;
@@ -372,7 +509,94 @@ float gps_distance_between (float lat1, float long1, float lat2, float long2)
   delta = sqrt(delta); 
   float denom = (slat1 * slat2) + (clat1 * clat2 * cdlong); 
   delta = atan2(delta, denom); 
-  return delta * 6372795; 
+  return delta * GPS_EARTH_RADIUS_M; 
+}
+
+float gps_fast_distance_between (float lat1, float long1, float lat2, float long2)
+{
+  // flat-earth distance scaled by the cosine of the mean latitude; good for
+  // nearest/within tests where points are close together
+  float dlong = long2 - long1;
+  if (dlong > 180)
+    dlong -= 360;
+  else if (dlong < -180)
+    dlong += 360;
+  float x = radians(dlong) * cosf(radians((lat1 + lat2) / 2));
+  float y = radians(lat2 - lat1);
+  return sqrtf(x * x + y * y) * GPS_EARTH_RADIUS_M;
+}
+
+int64_t gps_delta_longitude(long long1, long long2)
+{
+  int64_t dlong = (int64_t)long2 - long1;
+  if (dlong > (int64_t)180 * GPS_ANGLE_SCALE)
+    dlong -= (int64_t)360 * GPS_ANGLE_SCALE;
+  else if (dlong < (int64_t)-180 * GPS_ANGLE_SCALE)
+    dlong += (int64_t)360 * GPS_ANGLE_SCALE;
+  return dlong;
+}
+
+/* Distance matrix kernel. Destinations are processed in tiles of
+ * GPS_MATRIX_TILE whose sines and cosines are computed once and stay in
+ * cache while every origin is run against them. The longitude difference
+ * terms come from the angle-difference identities, so the inner loop is
+ * multiplies, one sqrt and one atan2 per pair.
+ */
+static void gps_distance_matrix_tiled(const float *lat1, const float *long1, unsigned m,
+  const float *lat2, const float *long2, unsigned n, float *out, uint32_t *out_u32)
+{
+  float slat2[GPS_MATRIX_TILE], clat2[GPS_MATRIX_TILE];
+  float slong2[GPS_MATRIX_TILE], clong2[GPS_MATRIX_TILE];
+  unsigned j0, i, j, tile;
+
+  for (j0 = 0; j0 < n; j0 += GPS_MATRIX_TILE)
+  {
+    tile = n - j0 < GPS_MATRIX_TILE ? n - j0 : GPS_MATRIX_TILE;
+    for (j = 0; j < tile; ++j)
+    {
+      float lat = radians(lat2[j0 + j]), lon = radians(long2[j0 + j]);
+      slat2[j] = sinf(lat);
+      clat2[j] = cosf(lat);
+      slong2[j] = sinf(lon);
+      clong2[j] = cosf(lon);
+    }
+
+    for (i = 0; i < m; ++i)
+    {
+      float lat = radians(lat1[i]), lon = radians(long1[i]);
+      float slat1 = sinf(lat), clat1 = cosf(lat);
+      float slong1 = sinf(lon), clong1 = cosf(lon);
+      size_t row = (size_t)i * n + j0;
+
+      for (j = 0; j < tile; ++j)
+      {
+        // sin/cos of (long1 - long2)
+        float sdlong = slong1 * clong2[j] - clong1 * slong2[j];
+        float cdlong = clong1 * clong2[j] + slong1 * slong2[j];
+        float y = clat1 * slat2[j] - slat1 * clat2[j] * cdlong;
+        float x = clat2[j] * sdlong;
+        float denom = slat1 * slat2[j] + clat1 * clat2[j] * cdlong;
+        float d = atan2f(sqrtf(y * y + x * x), denom) * GPS_EARTH_RADIUS_M;
+
+        if (out)
+          out[row + j] = d;
+        else
+          out_u32[row + j] = (uint32_t)(d + 0.5f);
+      }
+    }
+  }
+}
+
+void gps_distance_matrix(const float *lat1, const float *long1, unsigned m,
+  const float *lat2, const float *long2, unsigned n, float *out)
+{
+  gps_distance_matrix_tiled(lat1, long1, m, lat2, long2, n, out, NULL);
+}
+
+void gps_distance_matrix_u32(const float *lat1, const float *long1, unsigned m,
+  const float *lat2, const float *long2, unsigned n, uint32_t *out)
+{
+  gps_distance_matrix_tiled(lat1, long1, m, lat2, long2, n, NULL, out);
 }
 
 float gps_course_to (float lat1, float long1, float lat2, float long2) 
@@ -403,43 +627,159 @@ const char *gps_cardinal (float course)
   return directions[direction % 16];
 }
 
+/* Seqlock read side: copies the committed fix, retrying while a commit is
+ * in progress or if one completed during the copy. Every getter reads
+ * through this, so no caller ever sees fields from two different fixes.
+ * Returns the sequence the copy belongs to.
+ */
+static unsigned int gps_snapshot(const gps_parser *gps, gps_fix *fix)
+{
+  unsigned int seq;
+
+  do
+  {
+    while ((seq = __atomic_load_n(&gps->_fix_seq, __ATOMIC_ACQUIRE)) & 1)
+      ;
+    *fix = gps->_fix;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (__atomic_load_n(&gps->_fix_seq, __ATOMIC_RELAXED) != seq);
+  return seq;
+}
+
+// milliseconds since an uptime() stamp of the fix
+static unsigned long gps_age(unsigned long stamp)
+{
+  return stamp == GPS_INVALID_FIX_TIME ? GPS_INVALID_AGE : uptime() - stamp;
+}
+
 // lat/long in hundred thousandths of a degree and age of fix in milliseconds
 void gps_get_position(long *latitude, long *longitude, unsigned long *fix_age)
 {
+  gps_get_position_r(&_gps, latitude, longitude, fix_age);
+}
+
+void gps_get_position_r(const gps_parser *gps, long *latitude, long *longitude, unsigned long *fix_age)
+{
+  gps_fix fix;
+  bool valid;
+
+  gps_snapshot(gps, &fix);
+  valid = fix.latitude != GPS_INVALID_ANGLE;
   if (latitude)
-	*latitude = _latitude;
+	*latitude = valid ? fix.latitude / (GPS_ANGLE_SCALE / 100000) : GPS_INVALID_ANGLE;
   if (longitude)
-	*longitude = _longitude;
+	*longitude = valid ? fix.longitude / (GPS_ANGLE_SCALE / 100000) : GPS_INVALID_ANGLE;
   if (fix_age)
-	*fix_age = (_last_position_fix == GPS_INVALID_FIX_TIME) ? 
-		GPS_INVALID_AGE : uptime() - _last_position_fix;
+	*fix_age = gps_age(fix.last_position_fix);
+}
+
+void gps_get_position_e7(long *latitude, long *longitude, unsigned long *fix_age)
+{
+  gps_get_position_e7_r(&_gps, latitude, longitude, fix_age);
+}
+
+void gps_get_position_e7_r(const gps_parser *gps, long *latitude, long *longitude, unsigned long *fix_age)
+{
+  gps_fix fix;
+
+  gps_snapshot(gps, &fix);
+  if (latitude)
+	*latitude = fix.latitude;
+  if (longitude)
+	*longitude = fix.longitude;
+  if (fix_age)
+	*fix_age = gps_age(fix.last_position_fix);
+}
+
+unsigned int gps_generation(void)
+{
+  return gps_generation_r(&_gps);
+}
+
+unsigned int gps_generation_r(const gps_parser *gps)
+{
+  // the sequence advances by two per commit
+  return __atomic_load_n(&gps->_fix_seq, __ATOMIC_ACQUIRE) >> 1;
+}
+
+void gps_get_fix(gps_fix *fix)
+{
+  gps_get_fix_r(&_gps, fix);
+}
+
+void gps_get_fix_r(const gps_parser *gps, gps_fix *fix)
+{
+  gps_snapshot(gps, fix);
 }
 
 // date as ddmmyy, time as hhmmsscc, and age in milliseconds
 void gps_get_datetime(unsigned long *date, unsigned long *time, unsigned long *age)
 {
+  gps_get_datetime_r(&_gps, date, time, age);
+}
+
+void gps_get_datetime_r(const gps_parser *gps, unsigned long *date, unsigned long *time, unsigned long *age)
+{
+  gps_fix fix;
+
+  gps_snapshot(gps, &fix);
   if (date)
-	*date = _date;
+	*date = fix.date;
   if (time)
-	*time = _time;
+	*time = fix.time;
   if (age)
-	*age = _last_time_fix == GPS_INVALID_FIX_TIME ? 
-		GPS_INVALID_AGE : uptime() - _last_time_fix;
+	*age = gps_age(fix.last_time_fix);
 }
 
 void gps_f_get_position(float *latitude, float *longitude, unsigned long *fix_age)
 {
-  long lat, lon;
-  gps_get_position(&lat, &lon, fix_age);
-  *latitude = lat == GPS_INVALID_ANGLE ? GPS_INVALID_F_ANGLE : (lat / 100000.0);
-  *longitude = lat == GPS_INVALID_ANGLE ? GPS_INVALID_F_ANGLE : (lon / 100000.0);
+  gps_f_get_position_r(&_gps, latitude, longitude, fix_age);
+}
+
+// Returns the float views for the current fix, refreshing them first if a
+// new fix has been committed since they were last computed. Like the other
+// accessors this is meant for the thread that feeds the parser, which is
+// why the gps_f_ getters take a writable parser
+static const gps_f_cache *gps_f_view(gps_parser *gps)
+{
+  gps_f_cache *f = &gps->_f;
+  unsigned int generation = gps_generation_r(gps);
+
+  if (f->generation != generation)
+  {
+    gps_fix fix;
+    generation = gps_snapshot(gps, &fix) >> 1;
+    f->latitude = fix.latitude == GPS_INVALID_ANGLE ? GPS_INVALID_F_ANGLE : (fix.latitude / (double)GPS_ANGLE_SCALE);
+    f->longitude = fix.latitude == GPS_INVALID_ANGLE ? GPS_INVALID_F_ANGLE : (fix.longitude / (double)GPS_ANGLE_SCALE);
+    f->altitude = fix.altitude == GPS_INVALID_ALTITUDE ? GPS_INVALID_F_ALTITUDE : fix.altitude / 100.0;
+    f->course = fix.course == GPS_INVALID_ANGLE ? GPS_INVALID_F_ANGLE : fix.course / 100.0;
+    f->speed_knots = fix.speed == GPS_INVALID_SPEED ? GPS_INVALID_F_SPEED : fix.speed / 100.0;
+    f->position_fix = fix.last_position_fix;
+    f->generation = generation;
+  }
+  return f;
+}
+
+void gps_f_get_position_r(gps_parser *gps, float *latitude, float *longitude, unsigned long *fix_age)
+{
+  const gps_f_cache *f = gps_f_view(gps);
+  *latitude = f->latitude;
+  *longitude = f->longitude;
+  if (fix_age)
+    *fix_age = gps_age(f->position_fix);
 }
 
 void gps_crack_datetime(int *year, byte *month, byte *day, 
   byte *hour, byte *minute, byte *second, byte *hundredths, unsigned long *age)
+{
+  gps_crack_datetime_r(&_gps, year, month, day, hour, minute, second, hundredths, age);
+}
+
+void gps_crack_datetime_r(const gps_parser *gps, int *year, byte *month, byte *day, 
+  byte *hour, byte *minute, byte *second, byte *hundredths, unsigned long *age)
 {
   unsigned long date, time;
-  gps_get_datetime(&date, &time, age);
+  gps_get_datetime_r(gps, &date, &time, age);
   if (year) 
   {
     *year = date % 100;
@@ -453,36 +793,72 @@ void gps_crack_datetime(int *year, byte *month, byte *day,
   if (hundredths) *hundredths = time % 100;
 }
 
-float gps_f_altitude()    
+// days from 1970-01-01 to a Gregorian date
+static int64_t days_from_civil(int year, unsigned month, unsigned day)
 {
-  return _altitude == GPS_INVALID_ALTITUDE ? GPS_INVALID_F_ALTITUDE : _altitude / 100.0;
+  int era;
+  unsigned yoe, doy, doe;
+
+  year -= month <= 2;
+  era = (year >= 0 ? year : year - 399) / 400;
+  yoe = (unsigned)(year - era * 400);
+  doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return (int64_t)era * 146097 + doe - 719468;
 }
 
-float gps_f_course()
+bool gps_fix_time_ms(const gps_fix *fix, int64_t *ms)
 {
-  return _course == GPS_INVALID_ANGLE ? GPS_INVALID_F_ANGLE : _course / 100.0;
+  unsigned long date = fix->date, time = fix->time;
+  unsigned day = date / 10000, month = date / 100 % 100;
+  unsigned hour = time / 1000000, minute = time / 10000 % 100, second = time / 100 % 100;
+  int year = (int)(date % 100);
+
+  if (date == GPS_INVALID_DATE || time == GPS_INVALID_TIME || day < 1 || day > 31 ||
+      month < 1 || month > 12 || hour > 23 || minute > 59 || second > 60)
+    return false;
+  year += year > 80 ? 1900 : 2000;   // as gps_crack_datetime()
+  *ms = ((days_from_civil(year, month, day) * 24 + hour) * 60 + minute) * 60000 +
+    second * 1000 + time % 100 * 10;
+  return true;
 }
 
-float gps_f_speed_knots() 
+float gps_f_altitude()    { return gps_f_altitude_r(&_gps); }
+float gps_f_course()      { return gps_f_course_r(&_gps); }
+float gps_f_speed_knots() { return gps_f_speed_knots_r(&_gps); }
+float gps_f_speed_mph()   { return gps_f_speed_mph_r(&_gps); }
+float gps_f_speed_mps()   { return gps_f_speed_mps_r(&_gps); }
+float gps_f_speed_kmph()  { return gps_f_speed_kmph_r(&_gps); }
+
+float gps_f_altitude_r(gps_parser *gps)
 {
-  return _speed == GPS_INVALID_SPEED ? GPS_INVALID_F_SPEED : _speed / 100.0;
+  return gps_f_view(gps)->altitude;
 }
 
-float gps_f_speed_mph()   
-{ 
-  float sk = gps_f_speed_knots();
-  return sk == GPS_INVALID_F_SPEED ? GPS_INVALID_F_SPEED : GPS_MPH_PER_KNOT * gps_f_speed_knots(); 
+float gps_f_course_r(gps_parser *gps)
+{
+  return gps_f_view(gps)->course;
+}
+
+float gps_f_speed_knots_r(gps_parser *gps)
+{
+  return gps_f_view(gps)->speed_knots;
 }
 
-float gps_f_speed_mps()   
+float gps_f_speed_mph_r(gps_parser *gps)
 { 
-  float sk = gps_f_speed_knots();
-  return sk == GPS_INVALID_F_SPEED ? GPS_INVALID_F_SPEED : GPS_MPS_PER_KNOT * gps_f_speed_knots(); 
+  float sk = gps_f_speed_knots_r(gps);
+  return sk == GPS_INVALID_F_SPEED ? GPS_INVALID_F_SPEED : GPS_MPH_PER_KNOT * sk; 
 }
 
-float gps_f_speed_kmph()  
+float gps_f_speed_mps_r(gps_parser *gps)
 { 
-  float sk = gps_f_speed_knots();
-  return sk == GPS_INVALID_F_SPEED ? GPS_INVALID_F_SPEED : GPS_KMPH_PER_KNOT * gps_f_speed_knots(); 
+  float sk = gps_f_speed_knots_r(gps);
+  return sk == GPS_INVALID_F_SPEED ? GPS_INVALID_F_SPEED : GPS_MPS_PER_KNOT * sk; 
 }
 
+float gps_f_speed_kmph_r(gps_parser *gps)
+{ 
+  float sk = gps_f_speed_knots_r(gps);
+  return sk == GPS_INVALID_F_SPEED ? GPS_INVALID_F_SPEED : GPS_KMPH_PER_KNOT * sk; 
+}
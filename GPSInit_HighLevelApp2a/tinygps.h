@@ -25,11 +25,15 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 // typedef char bool;  -- use below instead
 #include <stdbool.h>
+#include <stdint.h>
 typedef unsigned char byte;
 #define false 0
 #define true 1
 
 #define PI 3.14159265
+#define GPS_EARTH_RADIUS_M 6372795
+#define GPS_ANGLE_SCALE 10000000L     // gps_fix latitude/longitude units per degree
+#define GPS_METERS_PER_LAT_UNIT ((float)(GPS_EARTH_RADIUS_M * PI / 180 / GPS_ANGLE_SCALE))
 #define TWO_PI 2*PI
 
 #define sq(x) ((x)*(x))
@@ -49,6 +53,8 @@ typedef unsigned char byte;
 #define GPS_MILES_PER_METER 0.00062137112
 #define GPS_KM_PER_METER 0.001
 // #define GPS_NO_STATS
+// #define GPS_NO_GPRMC  -- drop sentence types that are not needed
+// #define GPS_NO_GPGGA
 
   enum {
     GPS_INVALID_AGE = 0xFFFFFFFF,
@@ -59,28 +65,154 @@ typedef unsigned char byte;
     GPS_INVALID_SPEED = 999999999, 
     GPS_INVALID_FIX_TIME = 0xFFFFFFFF,
     GPS_INVALID_SATELLITES = 0xFF,
+    GPS_INVALID_QUALITY = 0xFF,
     GPS_INVALID_HDOP = 0xFFFFFFFF
   };
 
+  enum {
+	GPS_SENTENCE_GPGGA,
+	GPS_SENTENCE_GPRMC,
+	GPS_SENTENCE_OTHER
+  };
+
+  // last committed fix; updated as a whole when a sentence passes its checksum
+  typedef struct gps_fix {
+    unsigned long time;               // hhmmsscc
+    unsigned long date;               // ddmmyy
+    long latitude;                    // 10^-7 degree (GPS_ANGLE_SCALE), about 1 cm
+    long longitude;                   // valid whenever latitude is
+    long altitude;                    // centimeters
+    unsigned long speed;              // 100ths of a knot
+    unsigned long course;             // 100ths of a degree
+    unsigned long hdop;               // 100ths
+    unsigned short numsats;
+    byte quality;                     // GGA fix quality: 1 GPS, 2 DGPS, 4/5 RTK, ...
+    unsigned long last_time_fix;      // uptime() of the time/position terms
+    unsigned long last_position_fix;
+  } gps_fix;
+
+  // float views of the committed fix, recomputed only when the fix changes
+  typedef struct gps_f_cache {
+    unsigned int generation;          // gps_generation_r() they were computed for
+    float latitude;
+    float longitude;
+    float altitude;
+    float course;
+    float speed_knots;
+    unsigned long position_fix;       // last_position_fix of the same fix, for its age
+  } gps_f_cache;
+
+  // parser state for one NMEA stream; the gps_* functions below operate on
+  // a shared default instance, the *_r variants on a caller-owned one
+  typedef struct gps_parser {
+    // committed properties and the sequence counter guarding them: odd while
+    // a commit is in progress, see gps_get_fix_r()
+    gps_fix _fix;
+    unsigned int _fix_seq;
+    gps_f_cache _f;
+
+    // properties of the sentence being parsed
+    unsigned long _new_time;
+    unsigned long _new_date;
+    long _new_latitude;
+    long _new_longitude;
+    long _new_altitude;
+    unsigned long  _new_speed;
+    unsigned long  _new_course;
+    unsigned long  _new_hdop;
+    unsigned short _new_numsats;
+    byte _new_quality;
+    unsigned long _new_time_fix;
+    unsigned long _new_position_fix;
+
+    // parsing state variables
+    byte _parity;
+    bool _is_checksum_term;
+    char _term[15];
+    byte _sentence_type;
+    byte _term_number;
+    byte _term_offset;
+    bool _is_gps_data_good;
+
+#ifndef GPS_NO_STATS
+    // statistics
+    unsigned long _encoded_characters;
+    unsigned short _good_sentences;
+    unsigned short _failed_checksum;
+    unsigned short _passed_checksum;
+#endif
+  } gps_parser;
+
+  // static initializer matching gps_parser_init()
+#define GPS_PARSER_INIT { \
+    ._fix = { .time = GPS_INVALID_TIME, .date = GPS_INVALID_DATE, \
+      .latitude = GPS_INVALID_ANGLE, .longitude = GPS_INVALID_ANGLE, \
+      .altitude = GPS_INVALID_ALTITUDE, .speed = GPS_INVALID_SPEED, \
+      .course = GPS_INVALID_ANGLE, .hdop = GPS_INVALID_HDOP, \
+      .numsats = GPS_INVALID_SATELLITES, .quality = GPS_INVALID_QUALITY, \
+      .last_time_fix = GPS_INVALID_FIX_TIME, .last_position_fix = GPS_INVALID_FIX_TIME }, \
+    ._f = { .generation = 0xFFFFFFFF }, \
+    ._sentence_type = GPS_SENTENCE_OTHER }
+
+  // reset a parser context to the no-fix state
+  void gps_parser_init(gps_parser *gps);
+
   // process one character received from GPS
   bool encode(char c);
   bool gps_encode(char c);
+  bool gps_encode_r(gps_parser *gps, char c);
 
-  // lat/long in hundred thousandths of a degree and age of fix in milliseconds
+  // process a block of received characters; returns the number of sentences
+  // that passed the checksum test and were committed
+  unsigned int gps_encode_buffer(const char *buf, unsigned int len);
+  unsigned int gps_encode_buffer_r(gps_parser *gps, const char *buf, unsigned int len);
+
+  // lat/long in hundred thousandths of a degree and age of fix in milliseconds;
+  // the original TinyGPS resolution, kept for existing callers
   void gps_get_position(long *latitude, long *longitude, unsigned long *fix_age);
+  void gps_get_position_r(const gps_parser *gps, long *latitude, long *longitude, unsigned long *fix_age);
+
+  // lat/long at full resolution, in 10^-7 degree, and age of fix in milliseconds
+  void gps_get_position_e7(long *latitude, long *longitude, unsigned long *fix_age);
+  void gps_get_position_e7_r(const gps_parser *gps, long *latitude, long *longitude, unsigned long *fix_age);
+
+  // number of fixes committed so far; cheap enough to poll, so callers can
+  // skip work entirely while it is unchanged
+  unsigned int gps_generation(void);
+  unsigned int gps_generation_r(const gps_parser *gps);
+
+  // consistent copy of the last committed fix. Safe to call from a thread
+  // other than the one feeding gps_encode_r(); never blocks the writer.
+  // The other getters read through the same snapshot
+  void gps_get_fix(gps_fix *fix);
+  void gps_get_fix_r(const gps_parser *gps, gps_fix *fix);
 
   // date as ddmmyy, time as hhmmsscc, and age in milliseconds
   void gps_get_datetime(unsigned long *date, unsigned long *time, unsigned long *age);
+  void gps_get_datetime_r(const gps_parser *gps, unsigned long *date, unsigned long *time, unsigned long *age);
 
+  // the gps_f_ getters refresh the parser's float cache, so take it writable
   void gps_f_get_position(float *latitude, float *longitude, unsigned long *fix_age);
+  void gps_f_get_position_r(gps_parser *gps, float *latitude, float *longitude, unsigned long *fix_age);
   void gps_crack_datetime(int *year, byte *month, byte *day, 
     byte *hour, byte *minute, byte *second, byte *hundredths, unsigned long *fix_age);
+  void gps_crack_datetime_r(const gps_parser *gps, int *year, byte *month, byte *day, 
+    byte *hour, byte *minute, byte *second, byte *hundredths, unsigned long *fix_age);
+  // date and time of a fix as milliseconds since 1970-01-01 UTC, for
+  // arithmetic across midnight; false if either is missing or malformed
+  bool gps_fix_time_ms(const gps_fix *fix, int64_t *ms);
   float gps_f_altitude(void);
   float gps_f_course(void);
   float gps_f_speed_knots(void);
   float gps_f_speed_mph(void);
   float gps_f_speed_mps(void);
   float gps_f_speed_kmph(void);
+  float gps_f_altitude_r(gps_parser *gps);
+  float gps_f_course_r(gps_parser *gps);
+  float gps_f_speed_knots_r(gps_parser *gps);
+  float gps_f_speed_mph_r(gps_parser *gps);
+  float gps_f_speed_mps_r(gps_parser *gps);
+  float gps_f_speed_kmph_r(gps_parser *gps);
 
   static int library_version(void) { return GPS_VERSION; }
 
@@ -88,21 +220,47 @@ typedef unsigned char byte;
   static float gps_course_to (float lat1, float long1, float lat2, float long2);
   static const char *gps_cardinal(float course);
 
+  // equirectangular approximation of gps_distance_between(): one cos() and a
+  // sqrt() instead of eight trig calls, within 0.1% below a few tens of km
+  float gps_fast_distance_between (float lat1, float long1, float lat2, float long2);
+
+  // long2 - long1 in gps_fix units, taken the short way round across the
+  // antimeridian; 64-bit since the raw difference does not fit a 32-bit long.
+  // Times GPS_METERS_PER_LAT_UNIT and the cosine of the latitude it is metres
+  // east, as in gps_fast_distance_between()
+  int64_t gps_delta_longitude(long long1, long long2);
+
+  // great-circle distances from m origins to n destinations, all given as
+  // separate latitude and longitude arrays in signed decimal degrees. Fills
+  // out[i * n + j] with the distance in meters from origin i to destination j,
+  // matching gps_distance_between() without any per-pair sin/cos calls
+#define GPS_MATRIX_TILE 64
+  void gps_distance_matrix(const float *lat1, const float *long1, unsigned m,
+    const float *lat2, const float *long2, unsigned n, float *out);
+  void gps_distance_matrix_u32(const float *lat1, const float *long1, unsigned m,
+    const float *lat2, const float *long2, unsigned n, uint32_t *out);
+
 #ifndef GPS_NO_STATS
   void gps_stats(unsigned long *chars, unsigned short *good_sentences, unsigned short *failed_cs);
+  void gps_stats_r(const gps_parser *gps, unsigned long *chars, unsigned short *good_sentences, unsigned short *failed_cs);
 #endif
 
+  // NMEA character classes, shared by everything that splits sentences into terms
   enum {
-	GPS_SENTENCE_GPGGA,
-	GPS_SENTENCE_GPRMC,
-	GPS_SENTENCE_OTHER
+    GPS_CC_ORDINARY,
+    GPS_CC_COMMA,     // field separator, counted in the parity
+    GPS_CC_END,       // \r or \n
+    GPS_CC_STAR,      // start of the checksum term
+    GPS_CC_DOLLAR,    // start of a sentence
+    GPS_CC_COUNT
   };
+  extern const byte gps_char_class[256];
 
   // internal utilities
   int from_hex(char a);
-  unsigned long gps_parse_decimal(void);
-  unsigned long gps_parse_degrees(void);
-  bool gps_term_complete(void);
+  unsigned long gps_parse_decimal(const gps_parser *gps);
+  unsigned long gps_parse_degrees(const gps_parser *gps);
+  bool gps_term_complete(gps_parser *gps);
   bool gpsisdigit(char c);
   long gpsatol(const char *str);
   int gpsstrcmp(const char *str1, const char *str2);
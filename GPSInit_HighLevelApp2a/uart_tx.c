@@ -0,0 +1,99 @@
+/* Licensed under the MIT License. */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <applibs/log.h>
+#include "uart_tx.h"
+
+static int SetWriteArmed(UartTxQueue *queue, bool armed)
+{
+    if (queue->writeArmed == armed) {
+        return 0;
+    }
+    uint32_t mask = queue->baseEventMask | (armed ? EPOLLOUT : 0);
+    if (RegisterEventHandlerToEpoll(queue->epollFd, queue->fd, queue->eventData, mask) != 0) {
+        return -1;
+    }
+    queue->writeArmed = armed;
+    return 0;
+}
+
+void UartTx_Init(UartTxQueue *queue, int fd, int epollFd, EventData *eventData,
+                 uint32_t baseEventMask, uint8_t *buffer, size_t capacity)
+{
+    memset(queue, 0, sizeof(*queue));
+    queue->fd = fd;
+    queue->epollFd = epollFd;
+    queue->eventData = eventData;
+    queue->baseEventMask = baseEventMask;
+    queue->buffer = buffer;
+    queue->capacity = capacity;
+}
+
+size_t UartTx_Free(const UartTxQueue *queue)
+{
+    return queue->capacity - queue->count;
+}
+
+bool UartTx_Pending(const UartTxQueue *queue)
+{
+    return queue->count != 0;
+}
+
+int UartTx_Enqueue(UartTxQueue *queue, const void *data, size_t length)
+{
+    if (length > UartTx_Free(queue)) {
+        queue->rejected++;
+        return -1;
+    }
+
+    // Writing is deferred to the next EPOLLOUT so that messages queued in the same
+    // pass of the event loop are coalesced into one write. Arm it before copying, so
+    // a failure leaves nothing queued and the caller can safely retry.
+    if (SetWriteArmed(queue, true) != 0) {
+        Log_Debug("ERROR: Could not request UART writable events: %s (%d).\n", strerror(errno),
+                  errno);
+        return -1;
+    }
+
+    // Copy in up to two pieces around the end of the ring
+    size_t tail = (queue->head + queue->count) % queue->capacity;
+    size_t first = queue->capacity - tail < length ? queue->capacity - tail : length;
+    memcpy(queue->buffer + tail, data, first);
+    memcpy(queue->buffer, (const uint8_t *)data + first, length - first);
+    queue->count += length;
+    queue->messages++;
+    return 0;
+}
+
+int UartTx_OnWritable(UartTxQueue *queue)
+{
+    while (queue->count != 0) {
+        struct iovec pieces[2];
+        size_t first = queue->capacity - queue->head < queue->count ? queue->capacity - queue->head
+                                                                    : queue->count;
+        pieces[0].iov_base = queue->buffer + queue->head;
+        pieces[0].iov_len = first;
+        pieces[1].iov_base = queue->buffer;
+        pieces[1].iov_len = queue->count - first;
+
+        ssize_t written = writev(queue->fd, pieces, pieces[1].iov_len != 0 ? 2 : 1);
+        if (written < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0; // UART full; EPOLLOUT stays armed
+            }
+            Log_Debug("ERROR: Could not write UART: %s (%d).\n", strerror(errno), errno);
+            return -1;
+        }
+        if (written == 0) {
+            return 0;
+        }
+        queue->writes++;
+        queue->head = (queue->head + (size_t)written) % queue->capacity;
+        queue->count -= (size_t)written;
+    }
+
+    queue->head = 0;
+    return SetWriteArmed(queue, false);
+}
@@ -0,0 +1,66 @@
+/* Licensed under the MIT License. */
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "epoll_timerfd_utilities.h"
+
+/// <summary>
+/// <para>Bounded, non-blocking transmit queue for a UART.</para>
+/// <para>Messages are queued whole or not at all, so output from different features
+/// never interleaves. Everything queued between two writable events goes out in a
+/// single write. EPOLLOUT is only requested while data is pending; the UART's event
+/// handler must call UartTx_OnWritable when it sees EPOLLOUT.</para>
+/// </summary>
+typedef struct UartTxQueue {
+    int fd;
+    int epollFd;
+    EventData *eventData;       ///< the fd's registration, shared with the receive side
+    uint32_t baseEventMask;     ///< events wanted when idle, normally EPOLLIN
+    bool writeArmed;            ///< EPOLLOUT currently requested
+    uint8_t *buffer;
+    size_t capacity;
+    size_t head;                ///< next byte to write
+    size_t count;               ///< bytes queued
+    unsigned long messages;     ///< accepted by UartTx_Enqueue
+    unsigned long rejected;     ///< refused for lack of space
+    unsigned long writes;       ///< write calls that sent data
+} UartTxQueue;
+
+/// <summary>
+///     Initializes a queue over caller-provided storage.
+/// </summary>
+/// <param name="queue">Queue to initialize</param>
+/// <param name="fd">UART file descriptor, opened non-blocking</param>
+/// <param name="epollFd">Epoll instance the UART is registered with</param>
+/// <param name="eventData">Event data the UART is registered with</param>
+/// <param name="baseEventMask">Events to keep registered when nothing is pending</param>
+/// <param name="buffer">Queue storage; must stay valid for the life of the queue</param>
+/// <param name="capacity">Size of buffer in bytes</param>
+void UartTx_Init(UartTxQueue *queue, int fd, int epollFd, EventData *eventData,
+                 uint32_t baseEventMask, uint8_t *buffer, size_t capacity);
+
+/// <summary>
+///     Queues a complete message for transmission. Never blocks.
+/// </summary>
+/// <returns>0 on success, or -1 if nothing was queued: there is not room for the whole
+/// message, or EPOLLOUT could not be requested</returns>
+int UartTx_Enqueue(UartTxQueue *queue, const void *data, size_t length);
+
+/// <summary>
+///     Bytes that can be queued right now.
+/// </summary>
+size_t UartTx_Free(const UartTxQueue *queue);
+
+/// <summary>
+///     True while bytes are waiting to be written.
+/// </summary>
+bool UartTx_Pending(const UartTxQueue *queue);
+
+/// <summary>
+///     Writes as much queued data as the UART accepts, and stops requesting EPOLLOUT
+///     once the queue is empty. Call on EPOLLOUT.
+/// </summary>
+/// <returns>0 on success, or -1 on a write error</returns>
+int UartTx_OnWritable(UartTxQueue *queue);